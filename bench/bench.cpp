@@ -0,0 +1,383 @@
+/* native benchmark: builds a synthetic corpus in memory and times each phase of a render against it,
+ * printing one JSON document; build with -DNODE_VGMSTREAM_BENCH=ON */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/endian.hpp"
+#include "../src/render.hpp"
+#include "../src/streamfile.hpp"
+
+extern "C" {
+#include "vgmstream/version.h"
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double Pi = 3.14159265358979323846;
+
+struct Sample {
+  std::string name;
+  std::string filename;
+  std::string codec;
+  int channels;
+  std::vector<uint8_t> data;
+};
+
+struct Timing {
+  double min_ms;
+  double mean_ms;
+};
+
+/* best and average of `iterations` runs of `job` */
+auto measure(const int iterations, const std::function<void()> &job) -> Timing {
+  double total = 0;
+  double best = INFINITY;
+  for (int i = 0; i < iterations; ++i) {
+    auto begin = Clock::now();
+    job();
+    auto elapsed = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    total += elapsed;
+    best = std::min(best, elapsed);
+  }
+  return {best, total / iterations};
+}
+
+/* reads one byte per page of what a phase produced, so the compiler cannot drop the work as dead */
+void consume(const void *data, const size_t bytes) {
+#if defined(__GNUC__) || defined(__clang__)
+  // as far as the optimizer knows, all of it is read here
+  asm volatile("" : : "r"(data) : "memory");
+#endif
+  static volatile uint8_t sink = 0;
+  const auto *view = static_cast<const uint8_t *>(data);
+  uint8_t checksum = 0;
+  for (size_t offset = 0; offset < bytes; offset += 4096) {
+    checksum ^= view[offset];
+  }
+  if (bytes > 0) {
+    checksum ^= view[bytes - 1];
+  }
+  sink = sink ^ checksum;
+}
+
+/* a few detuned sines and some noise per channel, so no codec gets an easy ride */
+auto synthesize(const int channels, const int sample_rate, const int32_t samples) -> std::vector<int16_t> {
+  std::vector<int16_t> pcm(static_cast<size_t>(samples) * channels);
+  uint32_t noise = 0x12345678;
+  for (int32_t i = 0; i < samples; ++i) {
+    auto t = static_cast<double>(i) / sample_rate;
+    for (int channel = 0; channel < channels; ++channel) {
+      noise = noise * 1664525 + 1013904223;
+      auto tone = 0.4 * std::sin(2 * Pi * (220.0 + 55.0 * channel) * t) + 0.2 * std::sin(2 * Pi * 3520.0 * t);
+      auto value = tone + 0.05 * (static_cast<int32_t>(noise >> 16) - 32768) / 32768.0;
+      pcm[static_cast<size_t>(i) * channels + channel] = static_cast<int16_t>(std::clamp(value, -1.0, 1.0) * 32767);
+    }
+  }
+  return pcm;
+}
+
+void put_u16le(std::vector<uint8_t> &out, const uint16_t value) {
+  out.push_back(value & 0xFF);
+  out.push_back(value >> 8);
+}
+
+void put_u32le(std::vector<uint8_t> &out, const uint32_t value) {
+  put_u16le(out, value & 0xFFFF);
+  put_u16le(out, value >> 16);
+}
+
+void put_u32be(std::vector<uint8_t> &out, const uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back((value >> shift) & 0xFF);
+  }
+}
+
+void put_tag(std::vector<uint8_t> &out, const char *tag) { out.insert(out.end(), tag, tag + 4); }
+
+/* RIFF/WAVE around `body`, with `extra` appended to the fmt chunk */
+auto riff(
+    const uint16_t format,
+    const int channels,
+    const int sample_rate,
+    const uint16_t block_align,
+    const uint16_t bits,
+    const std::vector<uint8_t> &extra,
+    const std::vector<uint8_t> &body
+) -> std::vector<uint8_t> {
+  std::vector<uint8_t> out;
+  put_tag(out, "RIFF");
+  put_u32le(out, 4 + 8 + 16 + extra.size() + 8 + body.size());
+  put_tag(out, "WAVE");
+  put_tag(out, "fmt ");
+  put_u32le(out, 16 + extra.size());
+  put_u16le(out, format);
+  put_u16le(out, channels);
+  put_u32le(out, sample_rate);
+  put_u32le(out, static_cast<uint32_t>(sample_rate) * block_align);
+  put_u16le(out, block_align);
+  put_u16le(out, bits);
+  out.insert(out.end(), extra.begin(), extra.end());
+  put_tag(out, "data");
+  put_u32le(out, body.size());
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+auto pcm16_wav(const std::vector<int16_t> &pcm, const int channels, const int sample_rate) -> std::vector<uint8_t> {
+  std::vector<uint8_t> body;
+  for (auto sample : pcm) {
+    put_u16le(body, static_cast<uint16_t>(sample));
+  }
+  return riff(0x0001, channels, sample_rate, channels * 2, 16, {}, body);
+}
+
+auto pcm8_wav(const std::vector<int16_t> &pcm, const int channels, const int sample_rate) -> std::vector<uint8_t> {
+  std::vector<uint8_t> body;
+  for (auto sample : pcm) {
+    body.push_back(static_cast<uint8_t>((sample >> 8) + 128));
+  }
+  return riff(0x0001, channels, sample_rate, channels, 8, {}, body);
+}
+
+auto float_wav(const std::vector<int16_t> &pcm, const int channels, const int sample_rate) -> std::vector<uint8_t> {
+  std::vector<uint8_t> body;
+  for (auto sample : pcm) {
+    auto value = static_cast<float>(sample) / 32768.0F;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_u32le(body, bits);
+  }
+  return riff(0x0003, channels, sample_rate, channels * 4, 32, {}, body);
+}
+
+constexpr int ImaIndexTable[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+constexpr int ImaStepTable[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+struct ImaState {
+  int predictor = 0;
+  int index = 0;
+
+  auto encode(const int sample) -> uint8_t {
+    auto step = ImaStepTable[index];
+    auto diff = sample - predictor;
+    uint8_t nibble = diff < 0 ? 8 : 0;
+    diff = std::abs(diff);
+    auto delta = step >> 3;
+    for (int bit = 4; bit > 0; bit >>= 1, step >>= 1) {
+      if (diff >= step) {
+        nibble |= bit;
+        diff -= step;
+        delta += step;
+      }
+    }
+    predictor = std::clamp(predictor + ((nibble & 8) != 0 ? -delta : delta), -32768, 32767);
+    index = std::clamp(index + ImaIndexTable[nibble], 0, 88);
+    return nibble;
+  }
+};
+
+/* Microsoft IMA ADPCM (0x0011): per-channel block headers, then 4 bytes of 8 nibbles per channel in turn */
+auto ima_wav(const std::vector<int16_t> &pcm, const int channels, const int sample_rate) -> std::vector<uint8_t> {
+  const uint16_t block_align = 512 * channels;
+  const int samples_per_block = (block_align - 4 * channels) * 8 / (4 * channels) + 1;
+  const auto total = static_cast<int>(pcm.size() / channels);
+  std::vector<ImaState> states(channels);
+  std::vector<uint8_t> body;
+
+  for (int block = 0; block * samples_per_block < total; ++block) {
+    auto first = block * samples_per_block;
+    auto sample_at = [&](int i, int channel) {
+      return i < total ? pcm[static_cast<size_t>(i) * channels + channel] : 0;
+    };
+    for (int channel = 0; channel < channels; ++channel) {
+      states[channel].predictor = sample_at(first, channel);
+      put_u16le(body, static_cast<uint16_t>(states[channel].predictor));
+      body.push_back(states[channel].index);
+      body.push_back(0);
+    }
+    for (int group = first + 1; group < first + samples_per_block; group += 8) {
+      for (int channel = 0; channel < channels; ++channel) {
+        for (int pair = 0; pair < 8; pair += 2) {
+          auto low = states[channel].encode(sample_at(group + pair, channel));
+          auto high = states[channel].encode(sample_at(group + pair + 1, channel));
+          body.push_back(low | (high << 4));
+        }
+      }
+    }
+  }
+
+  std::vector<uint8_t> extra;
+  put_u16le(extra, 2);
+  put_u16le(extra, samples_per_block);
+  return riff(0x0011, channels, sample_rate, block_align, 4, extra, body);
+}
+
+/* Sony VAG: PS-ADPCM frames of 28 samples, only the no-prediction filter with the best fitting shift */
+auto vag(const std::vector<int16_t> &pcm, const int sample_rate) -> std::vector<uint8_t> {
+  std::vector<uint8_t> body(16, 0);
+  for (size_t first = 0; first < pcm.size(); first += 28) {
+    int peak = 0;
+    for (size_t i = first; i < std::min(first + 28, pcm.size()); ++i) {
+      peak = std::max(peak, std::abs(static_cast<int>(pcm[i])));
+    }
+    int shift = 12;
+    while (shift > 0 && peak > (7 << (12 - shift))) {
+      --shift;
+    }
+    body.push_back(static_cast<uint8_t>(shift));
+    body.push_back(first + 28 >= pcm.size() ? 0x01 : 0x00);
+    for (size_t i = first; i < first + 28; i += 2) {
+      auto nibble = [&](size_t at) {
+        auto value = at < pcm.size() ? pcm[at] >> (12 - shift) : 0;
+        return static_cast<uint8_t>(std::clamp(value, -8, 7) & 0x0F);
+      };
+      body.push_back(nibble(i) | (nibble(i + 1) << 4));
+    }
+  }
+
+  std::vector<uint8_t> out;
+  put_tag(out, "VAGp");
+  put_u32be(out, 0x20);
+  put_u32be(out, 0);
+  put_u32be(out, body.size());
+  put_u32be(out, sample_rate);
+  out.resize(0x30, 0);
+  memcpy(out.data() + 0x20, "bench", 5);
+  out.insert(out.end(), body.begin(), body.end());
+  return out;
+}
+
+auto corpus(const int sample_rate, const int32_t samples) -> std::vector<Sample> {
+  std::vector<Sample> all;
+  for (auto channels : {1, 2, 6}) {
+    auto pcm = synthesize(channels, sample_rate, samples);
+    auto add = [&](const std::string &codec, const std::string &extension, std::vector<uint8_t> data) {
+      auto name = codec + "-" + std::to_string(channels) + "ch";
+      all.push_back({name, name + "." + extension, codec, channels, std::move(data)});
+    };
+    add("pcm16", "wav", pcm16_wav(pcm, channels, sample_rate));
+    if (channels <= 2) {
+      add("pcm8", "wav", pcm8_wav(pcm, channels, sample_rate));
+      add("float", "wav", float_wav(pcm, channels, sample_rate));
+      add("ms-ima", "wav", ima_wav(pcm, channels, sample_rate));
+    }
+    if (channels == 1) {
+      add("psx", "vag", vag(pcm, sample_rate));
+    }
+  }
+  return all;
+}
+
+void print_timing(const char *name, const Timing &timing, const bool last = false) {
+  printf("\"%s\": {\"minMs\": %.4f, \"meanMs\": %.4f}%s", name, timing.min_ms, timing.mean_ms, last ? "" : ", ");
+}
+
+}  // namespace
+
+auto main(int argc, char **argv) -> int {
+  int seconds = 10;
+  int iterations = 5;
+  const char *corpus_directory = nullptr;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--seconds") == 0) {
+      seconds = std::max(1, atoi(argv[i + 1]));
+    } else if (strcmp(argv[i], "--iterations") == 0) {
+      iterations = std::max(1, atoi(argv[i + 1]));
+    } else if (strcmp(argv[i], "--corpus") == 0) {
+      corpus_directory = argv[i + 1];
+    }
+  }
+
+  constexpr int sample_rate = 44100;
+  auto samples = corpus(sample_rate, seconds * sample_rate);
+
+  // the same files, for the Node-side bench to pick up
+  if (corpus_directory != nullptr) {
+    for (const auto &sample : samples) {
+      auto *file = fopen((std::string(corpus_directory) + "/" + sample.filename).c_str(), "wb");
+      if (file != nullptr) {
+        fwrite(sample.data.data(), 1, sample.data.size(), file);
+        fclose(file);
+      }
+    }
+  }
+
+  printf(
+      "{\"vgmstream\": \"%s\", \"seconds\": %d, \"iterations\": %d, \"results\": [", VGMSTREAM_VERSION, seconds,
+      iterations
+  );
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const auto &sample = samples[i];
+    auto open = [&] { return vgmstream_from_memory(sample.data.data(), sample.data.size(), 0, sample.filename); };
+    auto vgmstream = open();
+    if (!vgmstream) {
+      fprintf(stderr, "%s: vgmstream could not open the generated file\n", sample.name.c_str());
+      continue;
+    }
+    auto total = vgmstream_get_samples(vgmstream.get());
+    auto count = static_cast<size_t>(total) * sample.channels;
+
+    // container parse and codec setup, which vgmstream only ever does together
+    auto parse = measure(iterations, [&] { open(); });
+    // codec state only
+    auto reset = measure(iterations, [&] { reset_vgmstream(vgmstream.get()); });
+
+    std::vector<sample_t> pcm(count + static_cast<size_t>(Renderer::BlockSamples) * sample.channels);
+    RenderOptions raw;
+    raw.format = OutputFormat::S16;
+    auto decode = measure(iterations, [&] {
+      reset_vgmstream(vgmstream.get());
+      Renderer renderer(vgmstream, raw);
+      for (size_t done = 0; !renderer.finished();) {
+        done += renderer.render(reinterpret_cast<uint8_t *>(pcm.data() + done), Renderer::BlockSamples) *
+                static_cast<size_t>(sample.channels);
+      }
+    });
+    auto swap = measure(iterations, [&] { swap_bytes(pcm.data(), count); });
+    std::vector<float> floats(count);
+    auto to_float = measure(iterations, [&] {
+      samples_to_float(pcm.data(), floats.data(), count);
+      consume(floats.data(), count * sizeof(float));
+    });
+    auto copy = measure(iterations, [&] {
+      auto *buffer = static_cast<uint8_t *>(malloc(count * sizeof(sample_t)));
+      memcpy(buffer, pcm.data(), count * sizeof(sample_t));
+      consume(buffer, count * sizeof(sample_t));
+      free(buffer);
+    });
+
+    printf(
+        "%s{\"name\": \"%s\", \"codec\": \"%s\", \"channels\": %d, \"samples\": %d, \"inputBytes\": %zu, ",
+        i > 0 ? ", " : "", sample.name.c_str(), sample.codec.c_str(), sample.channels, total, sample.data.size()
+    );
+    printf("\"samplesPerSecond\": %.0f, ", total / (decode.min_ms / 1000.0));
+    print_timing("parse", parse);
+    print_timing("reset", reset);
+    print_timing("decode", decode);
+    print_timing("byteSwap", swap);
+    print_timing("toFloat", to_float);
+    print_timing("copy", copy, true);
+    printf("}");
+  }
+  printf("]}\n");
+  return 0;
+}
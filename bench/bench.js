@@ -0,0 +1,95 @@
+// Node-side benchmark: what a render costs once marshalling and the trip through the pool are included.
+// usage: node bench/bench.js [--iterations N] [files...]
+// without files it generates PCM .wav inputs; `vgmstream_bench --corpus DIR` writes the native corpus for it.
+
+const fs = require('fs')
+const path = require('path')
+
+const { VGMStream } = require('../lib')
+
+const args = process.argv.slice(2)
+let iterations = 5
+const files = []
+for (let i = 0; i < args.length; ++i) {
+  if (args[i] === '--iterations') {
+    iterations = Math.max(1, Number(args[++i]))
+  } else {
+    files.push(args[i])
+  }
+}
+
+const pcm16Wav = (channels, sampleRate, seconds) => {
+  const samples = sampleRate * seconds
+  const data = Buffer.alloc(samples * channels * 2)
+  for (let i = 0; i < samples; ++i) {
+    for (let channel = 0; channel < channels; ++channel) {
+      const value = 0.4 * Math.sin(2 * Math.PI * (220 + 55 * channel) * i / sampleRate) + 0.05 * (Math.random() * 2 - 1)
+      data.writeInt16LE(Math.round(value * 32767), (i * channels + channel) * 2)
+    }
+  }
+  const header = Buffer.alloc(44)
+  header.write('RIFF', 0)
+  header.writeUInt32LE(36 + data.length, 4)
+  header.write('WAVEfmt ', 8)
+  header.writeUInt32LE(16, 16)
+  header.writeUInt16LE(1, 20)
+  header.writeUInt16LE(channels, 22)
+  header.writeUInt32LE(sampleRate, 24)
+  header.writeUInt32LE(sampleRate * channels * 2, 28)
+  header.writeUInt16LE(channels * 2, 32)
+  header.writeUInt16LE(16, 34)
+  header.write('data', 36)
+  header.writeUInt32LE(data.length, 40)
+  return Buffer.concat([header, data])
+}
+
+const inputs = files.length > 0
+  ? files.map(file => ({ name: path.basename(file), buffer: fs.readFileSync(file) }))
+  : [1, 2, 6].map(channels => ({ name: `pcm16-${channels}ch.wav`, buffer: pcm16Wav(channels, 44100, 10) }))
+
+const now = () => Number(process.hrtime.bigint()) / 1e6
+
+const measure = async job => {
+  let best = Infinity
+  let total = 0
+  for (let i = 0; i < iterations; ++i) {
+    const begin = now()
+    await job()
+    const elapsed = now() - begin
+    best = Math.min(best, elapsed)
+    total += elapsed
+  }
+  return { minMs: best, meanMs: total / iterations }
+}
+
+const bench = async ({ name, buffer }) => {
+  const subSong = new VGMStream(buffer, name).selectSubSong(1)
+  const { numberOfSamples, channels } = subSong.info
+
+  const result = { name, channels, samples: numberOfSamples, inputBytes: buffer.length }
+  result.open = await measure(() => new VGMStream(buffer, name).selectSubSong(1).info)
+  for (const format of ['wav', 's16le', 'f32le', 'planar']) {
+    result[format] = await measure(() => subSong.renderSync({ format }))
+  }
+  result.async = await measure(() => subSong.render())
+  // a one-sample render is all overhead, the difference is the trip through the pool and back
+  const tinySync = await measure(() => subSong.renderSync({ end: 1 }))
+  const tinyAsync = await measure(() => subSong.render({ end: 1 }))
+  result.handoff = { minMs: tinyAsync.minMs - tinySync.minMs, meanMs: tinyAsync.meanMs - tinySync.meanMs }
+  result.samplesPerSecond = Math.round(numberOfSamples / (result.s16le.minMs / 1000))
+  return result
+}
+
+const main = async () => {
+  const results = []
+  for (const input of inputs) {
+    try {
+      results.push(await bench(input))
+    } catch (error) {
+      console.error(`${input.name}: ${error.message}`)
+    }
+  }
+  console.log(JSON.stringify({ vgmstream: VGMStream.version.version, node: process.version, iterations, results }, null, 2))
+}
+
+main()
@@ -1,4 +1,6 @@
 declare module 'node-vgmstream' {
+  import { Readable } from 'stream';
+
   interface VGMStreamVersion {
     version: string;
     extension: {
@@ -6,14 +8,144 @@ declare module 'node-vgmstream' {
       common: string[];
     };
   }
+  interface VGMStreamConfig {
+    /** native render threads, defaults to the hardware concurrency */
+    threads?: number;
+    /** renders waiting for a thread before new ones are rejected, 0 for unbounded */
+    maxQueue?: number;
+    /** memory budget of the render cache, 0 (the default) disables it; any cache option empties the cache */
+    cacheBytes?: number;
+    /** where renders evicted from memory are kept */
+    cacheDirectory?: string;
+    /** disk budget for `cacheDirectory`, unlimited by default */
+    cacheSpillBytes?: number;
+    /**
+     * file remembering sub-song counts and descriptions across restarts, keyed by each bank's content, size and
+     * file name and appended to as banks are parsed; starts over when written by another vgmstream version.
+     * Banks that needed companion files are left out. An empty string turns it off.
+     */
+    indexFile?: string;
+    /**
+     * bytes that whole renders may hold at once, estimated from each render's length, channels and format
+     * before it decodes; 0 (the default) turns the budget off. Async renders wait their turn in order,
+     * off the render threads, `renderSync` rejects when the budget is full, and a render bigger than the
+     * budget always rejects.
+     * Readers and streams are not counted.
+     */
+    memoryBudget?: number;
+    /** renders allowed to wait for memory at once, the next ones reject; unbounded by default */
+    memoryQueue?: number;
+  }
+  interface VGMStreamStats {
+    renders: {
+      /** threads in the pool */
+      threads: number;
+      /** pool threads busy right now */
+      active: number;
+      /** jobs waiting for a thread */
+      queued: number;
+      /** renders decoded to the end, cache hits excluded */
+      completed: number;
+      samplesDecoded: number;
+      bytesAllocated: number;
+      /** times an output buffer had to grow */
+      resizes: number;
+    };
+    /** whole renders are keyed by the input's content, the sub-song and the render options; banks that needed
+     * companion files are rendered without the cache */
+    cache: {
+      hits: number;
+      misses: number;
+      evictions: number;
+      spills: number;
+      spillHits: number;
+      entries: number;
+      bytes: number;
+      spilledEntries: number;
+      spilledBytes: number;
+    };
+    /** the `memoryBudget`: bytes held by admitted renders until their results reach JS */
+    memory: {
+      budget: number;
+      inUse: number;
+      peak: number;
+      /** renders waiting for memory */
+      waiting: number;
+      admitted: number;
+      rejected: number;
+    };
+    /** lookups answered by the `indexFile` instead of parsing */
+    index: {
+      hits: number;
+      misses: number;
+      /** records written this run */
+      appends: number;
+      banks: number;
+      subSongs: number;
+    };
+  }
   class VGMStream {
     static get version(): VGMStreamVersion;
+    static configure(config: VGMStreamConfig): void;
+    static get stats(): VGMStreamStats;
 
-    constructor(buffer: Buffer, filename?: string);
+    constructor(buffer: Buffer, filename?: string, options?: VGMStreamOpenOptions);
+    /** memory-maps the file instead of reading it, `filename` defaults to `path` */
+    constructor(path: string, filename?: string, options?: VGMStreamOpenOptions);
+    /** same as the constructor, resolving once the bank is parsed off the JS thread */
+    static open(input: Buffer | string, filename?: string, options?: VGMStreamOpenOptions): Promise<VGMStream>;
 
     get subSongCount(): number;
+    /** catalogue fields of every sub-song from a single pass over the bank, null where one fails to open */
+    listSubSongs(): (VGMStreamSubSongSummary | null)[];
+    /** same as `listSubSongs`, off the JS thread */
+    probe(): Promise<(VGMStreamSubSongSummary | null)[]>;
     /** 1-based */
     selectSubSong(index: number): VGMStreamSubSong;
+    /** same as `selectSubSong`, with the sub-song parsed off the JS thread so `info` and the first render skip it */
+    selectSubSongAsync(index: number): Promise<VGMStreamSubSong>;
+    /** renders the selected sub-songs on the native pool, calling back as each one completes */
+    renderEach(
+      options: VGMStreamBatchOptions,
+      /** `data` is `{ data, stats }` with the `stats` option */
+      callback: (error: Error | null, index: number, data?: VGMStreamOutput | VGMStreamRenderWithStats) => void,
+    ): Promise<void>;
+    /**
+     * same as `renderEach`, yielding results in completion order; starts on the first `next()` and keeps at
+     * most `concurrency` results rendering or waiting to be taken, and leaving the loop early aborts the rest
+     */
+    renderAll(options?: VGMStreamBatchOptions): AsyncIterableIterator<VGMStreamBatchResult>;
+  }
+  interface VGMStreamBatchOptions extends VGMStreamRenderOptions {
+    /** sub-songs rendered at once, defaults to the pool size */
+    concurrency?: number;
+    /** 1-based sub-songs to render, defaults to all of them */
+    indices?: number[];
+  }
+  interface VGMStreamOpenOptions {
+    /** companion files (.txth, headers of split formats...) by file name, used without copying */
+    files?: Record<string, Buffer>;
+    /** where to map companion files missing from `files` from; defaults to the directory of a path input */
+    directory?: string;
+    /** idle decoders kept to skip parsing on re-renders, defaults to 4 */
+    decoderPoolSize?: number;
+  }
+  interface VGMStreamSubSongSummary {
+    /** 1-based */
+    index: number;
+    name: string;
+    sampleRate: number;
+    channels: number;
+    numberOfSamples: number;
+    encoding: string;
+    /** only present when the sub-song loops */
+    loopStart?: number;
+    loopEnd?: number;
+  }
+  interface VGMStreamBatchResult {
+    index: number;
+    data?: VGMStreamOutput | VGMStreamRenderWithStats;
+    error?: Error;
   }
   interface VGMStreamSubSongInfo {
     version: string;
@@ -44,10 +176,161 @@ declare module 'node-vgmstream' {
       total: number;
     };
   }
+  /**
+   * - `wav`: 16-bit PCM .wav file (default)
+   * - `s16le`: raw interleaved little-endian int16 samples
+   * - `f32le`: raw interleaved little-endian float32 samples
+   * - `planar`: one Float32Array per channel
+   * - `flac`: a 16-bit .flac file, encoded as it decodes; up to 8 channels
+   */
+  type VGMStreamOutputFormat = 'wav' | 's16le' | 'f32le' | 'planar' | 'flac';
+  /** what a render produces for a given output format */
+  type VGMStreamOutput = Buffer | Float32Array[];
+  interface VGMStreamDecodeOptions {
+    format?: VGMStreamOutputFormat;
+    /** first sample to render */
+    start?: number;
+    /** sample to stop at (excluded), defaults to the end of the sub-song */
+    end?: number;
+    /** same as `start`, in seconds; ignored when `start` is given */
+    startTime?: number;
+    /** same as `end`, in seconds; ignored when `end` is given */
+    endTime?: number;
+    /** times the loop section is played, fractions allowed; defaults to 1 once any loop option is set */
+    loopCount?: number;
+    /** seconds of fade-out after the last loop */
+    fadeTime?: number;
+    /** seconds to keep playing after the last loop before the fade starts */
+    fadeDelay?: number;
+    /** play the file once, straight through its loop points */
+    ignoreLoop?: boolean;
+    /** loop the whole file when it has no loop points of its own */
+    forceLoop?: boolean;
+    /** keep playing the loop section until the end instead of fading out */
+    ignoreFade?: boolean;
+    /** loop endlessly; without an `end`, only readers and streams accept this */
+    playForever?: boolean;
+    /** write the loop points into a `smpl` chunk of the .wav output */
+    smplChunk?: boolean;
+    /** 0-based channels to keep, the others are dropped before decoding is done */
+    channels?: number[];
+    /** fold the channels into layers of this many channels each, mixed together */
+    layerChannels?: number;
+    /** 0-based layers to mix when `layerChannels` is set, all of them by default */
+    layers?: number[];
+    /** mix down to mono or stereo after the selection above */
+    downmix?: 'mono' | 'stereo';
+    /** resample to this rate while decoding; `start` and `end` still count samples at the sub-song's own rate */
+    sampleRate?: number;
+    /** filter length of the resampler, defaults to `'medium'` */
+    resampleQuality?: 'low' | 'medium' | 'high';
+    /**
+     * decode a whole render in up to this many pieces at once, for PCM sub-songs laid out flat or in plain
+     * interleave that play without loop or fade options; others render serially. Pieces run on idle render
+     * threads (see `configure`) or else on the render's own, capped at the render threads and the machine's
+     * cores. Not for streams.
+     */
+    parallel?: number;
+  }
+  interface VGMStreamRenderStats {
+    queueMs: number;
+    /** parse and codec setup, near zero when a pooled decoder was reused */
+    openMs: number;
+    /** held back by the `memoryBudget` */
+    memoryWaitMs: number;
+    decodeMs: number;
+    /** from the result being ready to it reaching JS */
+    deliverMs: number;
+    samples: number;
+    bytes: number;
+    allocatedBytes: number;
+    resizes: number;
+    cacheHit: boolean;
+  }
+  interface VGMStreamRenderWithStats {
+    data: VGMStreamOutput;
+    stats: VGMStreamRenderStats;
+  }
+  interface VGMStreamAnalysisOptions {
+    /** min/max pairs over this many equal slices of the render, for waveforms; none by default */
+    peaks?: number;
+    /** measure integrated loudness (ITU-R BS.1770) */
+    loudness?: boolean;
+    /** dBFS below which samples count as silence, defaults to -60 */
+    silenceThreshold?: number;
+  }
+  /** figures measured off the rendered output, levels as linear full-scale ratios */
+  interface VGMStreamAnalysis {
+    peak: number;
+    peakDb: number;
+    rms: number;
+    rmsDb: number;
+    /** LUFS, when asked for and anything was loud enough to pass the gates */
+    loudness?: number;
+    /** silent samples per channel at either end, the whole render when nothing is louder */
+    leadingSilence: number;
+    trailingSilence: number;
+    /** min then max of every slice, across all channels */
+    peaks?: Float32Array;
+  }
+  interface VGMStreamRenderWithAnalysis {
+    /** absent for `analysisOnly` renders */
+    data?: VGMStreamOutput;
+    stats?: VGMStreamRenderStats;
+    analysis: VGMStreamAnalysis;
+  }
+  interface VGMStreamSyncRenderOptions extends VGMStreamDecodeOptions {
+    /** milliseconds before the render is given up, time spent queued included */
+    timeout?: number;
+    /** resolve with `{ data, stats }` instead of the data alone */
+    stats?: boolean;
+    /** measure the output in the same pass and resolve with `{ data, analysis }`; never served from the cache */
+    analyze?: VGMStreamAnalysisOptions;
+    /** decode and measure without keeping any output, resolves with `{ analysis }` */
+    analysisOnly?: boolean;
+  }
+  interface VGMStreamRenderOptions extends VGMStreamSyncRenderOptions {
+    /** higher priorities leave the render queue first, defaults to 0 */
+    priority?: number;
+    /** stops the render at the next block and rejects with "render aborted" */
+    signal?: AbortSignal;
+  }
+  interface VGMStreamReaderOptions extends VGMStreamDecodeOptions {
+    /** samples per channel in each chunk, defaults to 8192 */
+    chunkSize?: number;
+  }
+  interface VGMStreamStreamOptions extends VGMStreamReaderOptions {
+    /** bytes buffered ahead of the consumer */
+    highWaterMark?: number;
+  }
+  class VGMStreamReader {
+    /** resolves with `null` once everything has been read */
+    read(): Promise<VGMStreamOutput | null>;
+    readSync(): VGMStreamOutput | null;
+    close(): void;
+  }
   class VGMStreamSubSong {
     get info(): VGMStreamSubSongInfo;
-    render(): Promise<Buffer>;
-    renderSync(): Buffer;
+    render(options: VGMStreamRenderOptions & { analysisOnly: true }): Promise<VGMStreamRenderWithAnalysis>;
+    render(
+      options: VGMStreamRenderOptions & { analyze: VGMStreamAnalysisOptions }
+    ): Promise<VGMStreamRenderWithAnalysis>;
+    render(options: VGMStreamRenderOptions & { stats: true }): Promise<VGMStreamRenderWithStats>;
+    render(options?: VGMStreamRenderOptions & { format?: 'wav' | 's16le' | 'f32le' }): Promise<Buffer>;
+    render(options: VGMStreamRenderOptions & { format: 'planar' }): Promise<Float32Array[]>;
+    render(options?: VGMStreamRenderOptions): Promise<VGMStreamOutput>;
+    renderSync(options: VGMStreamSyncRenderOptions & { analysisOnly: true }): VGMStreamRenderWithAnalysis;
+    renderSync(
+      options: VGMStreamSyncRenderOptions & { analyze: VGMStreamAnalysisOptions }
+    ): VGMStreamRenderWithAnalysis;
+    renderSync(options: VGMStreamSyncRenderOptions & { stats: true }): VGMStreamRenderWithStats;
+    renderSync(options?: VGMStreamSyncRenderOptions & { format?: 'wav' | 's16le' | 'f32le' }): Buffer;
+    renderSync(options: VGMStreamSyncRenderOptions & { format: 'planar' }): Float32Array[];
+    renderSync(options?: VGMStreamSyncRenderOptions): VGMStreamOutput;
+    /** pull-based reader keeping its own decoder open, the first chunk carries the .wav header if any;
+     * planar chunks make the stream an object stream of Float32Array[] */
+    openReader(options?: VGMStreamReaderOptions): VGMStreamReader;
+    stream(options?: VGMStreamStreamOptions): Readable;
   }
-  export { VGMStream };
+  export { VGMStream, VGMStreamSubSong, VGMStreamReader };
 }
@@ -1 +1,100 @@
-module.exports = require('bindings')('node-vgmstream');
+const { Readable } = require('stream');
+
+const addon = require('bindings')('node-vgmstream');
+
+addon.VGMStreamSubSong.prototype.stream = function stream(options = {}) {
+  const reader = this.openReader(options);
+  return new Readable({
+    objectMode: options.format === 'planar',
+    highWaterMark: options.highWaterMark,
+    read() {
+      reader.read().then(
+        chunk => this.push(chunk),
+        error => this.destroy(error),
+      );
+    },
+    destroy(error, callback) {
+      reader.close();
+      callback(error);
+    },
+  });
+};
+
+addon.VGMStream.prototype.renderAll = function renderAll(options = {}) {
+  const bank = this;
+
+  return (async function* completed() {
+    const count = Math.max(bank.subSongCount, 1);
+    const indices = options.indices ?? Array.from({ length: count }, (_, i) => i + 1);
+    if (!indices.every(index => Number.isInteger(index) && index >= 1 && index <= count)) {
+      throw new RangeError(`indices should hold integers from 1 to ${count}`);
+    }
+    const concurrency = options.concurrency ?? addon.VGMStream.stats.renders.threads;
+    if (!(concurrency >= 1)) {
+      throw new RangeError('concurrency should be a positive number');
+    }
+
+    // one sub-song per renderEach, so nothing renders ahead of the consumer; the timeout still covers the batch
+    const deadline = options.timeout === undefined ? undefined : Date.now() + Math.max(options.timeout, 0);
+    const controller = new AbortController();
+    const forward = () => controller.abort();
+    if (options.signal?.aborted) {
+      controller.abort();
+    }
+    options.signal?.addEventListener('abort', forward);
+
+    const results = [];
+    let next = 0;
+    let running = 0;
+    let wake = null;
+
+    const start = index => {
+      let result = { index, error: new Error('render was not reported') };
+      const settle = () => {
+        running -= 1;
+        results.push(result);
+        if (wake) {
+          wake();
+          wake = null;
+        }
+      };
+      running += 1;
+      bank
+        .renderEach(
+          {
+            ...options,
+            indices: [index],
+            concurrency: 1,
+            signal: controller.signal,
+            timeout: deadline === undefined ? undefined : Math.max(deadline - Date.now(), 0),
+          },
+          (error, _, data) => {
+            result = error ? { index, error } : { index, data };
+          },
+        )
+        .then(settle, settle);
+    };
+
+    try {
+      while (next < indices.length || running > 0 || results.length > 0) {
+        // what is taken makes room for the next render
+        while (next < indices.length && running + results.length < concurrency) {
+          start(indices[next]);
+          next += 1;
+        }
+        if (results.length > 0) {
+          yield results.shift();
+        } else {
+          await new Promise(resolve => {
+            wake = resolve;
+          });
+        }
+      }
+    } finally {
+      options.signal?.removeEventListener('abort', forward);
+      controller.abort();
+    }
+  })();
+};
+
+module.exports = addon;
@@ -0,0 +1,264 @@
+#ifndef SRC_ANALYSIS_HPP_
+#define SRC_ANALYSIS_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+extern "C" {
+#include "vgmstream/src/streamtypes.h"
+}
+
+/* what to measure while rendering */
+struct AnalysisOptions {
+  /* min/max pairs over this many equal slices of the render, for waveform display; 0 for none */
+  int peak_buckets = 0;
+  /* integrated loudness after ITU-R BS.1770, costs two biquads per sample and channel */
+  bool loudness = false;
+  /* samples quieter than this on every channel count as silence */
+  double silence_threshold_db = -60.0;
+};
+
+/* the figures, levels as linear full-scale ratios */
+struct Analysis {
+  double peak = 0;
+  double rms = 0;
+  std::optional<double> loudness;
+  std::vector<float> peaks;
+  int32_t leading_silence = 0;
+  int32_t trailing_silence = 0;
+};
+
+/* measures the rendered samples block by block, in order, so nothing has to be kept around */
+class Analyzer {
+ public:
+  /* `length` in samples per channel is what the peak slices divide, the whole render */
+  Analyzer(const int channels, const int sample_rate, const int32_t length, const AnalysisOptions &options)
+      : channels(channels),
+        length(length),
+        silence_threshold(static_cast<float>(std::pow(10.0, options.silence_threshold_db / 20.0))),
+        square_sums(channels, 0.0),
+        buckets(length > 0 ? options.peak_buckets : 0) {
+    if (buckets > 0) {
+      result.peaks.assign(static_cast<size_t>(buckets) * 2, 0.0F);
+    }
+    if (options.loudness) {
+      loudness.emplace(channels, sample_rate);
+    }
+  }
+
+  /* interleaved int16 or -1.0 to 1.0 floats, native-endian */
+  template <typename T>
+  void push(const T *src, const int32_t samples) {
+    constexpr float scale = std::is_same_v<T, sample_t> ? 1.0F / 32768.0F : 1.0F;
+
+    for (int32_t i = 0; i < samples; ++i, ++position) {
+      const T *frame = src + static_cast<size_t>(i) * channels;
+      float low = 0;
+      float high = 0;
+      for (int channel = 0; channel < channels; ++channel) {
+        auto value = static_cast<float>(frame[channel]) * scale;
+        square_sums[channel] += static_cast<double>(value) * value;
+        low = std::min(low, value);
+        high = std::max(high, value);
+      }
+
+      auto magnitude = std::max(-low, high);
+      peak = std::max(peak, magnitude);
+      if (magnitude > silence_threshold) {
+        if (first_loud < 0) {
+          first_loud = position;
+        }
+        last_loud = position;
+      }
+      if (buckets > 0) {
+        auto bucket = static_cast<size_t>(std::min<int64_t>(position * buckets / length, buckets - 1));
+        result.peaks[bucket * 2] = std::min(result.peaks[bucket * 2], low);
+        result.peaks[bucket * 2 + 1] = std::max(result.peaks[bucket * 2 + 1], high);
+      }
+    }
+
+    if (loudness) {
+      loudness->push(src, samples, scale);
+    }
+  }
+
+  /* the figures for everything pushed so far */
+  [[nodiscard]]
+  auto finish() const -> Analysis {
+    auto analysis = result;
+    analysis.peak = peak;
+    double total = 0;
+    for (auto sum : square_sums) {
+      total += sum;
+    }
+    analysis.rms = position > 0 ? std::sqrt(total / (static_cast<double>(position) * channels)) : 0.0;
+    if (first_loud < 0) {
+      analysis.leading_silence = static_cast<int32_t>(position);
+      analysis.trailing_silence = 0;
+    } else {
+      analysis.leading_silence = static_cast<int32_t>(first_loud);
+      analysis.trailing_silence = static_cast<int32_t>(position - 1 - last_loud);
+    }
+    if (loudness) {
+      analysis.loudness = loudness->integrated();
+    }
+    return analysis;
+  }
+
+ private:
+  /* K-weighting, then 400 ms gating blocks every 100 ms with the absolute and relative gates */
+  class Loudness {
+   public:
+    Loudness(const int channels, const int sample_rate)
+        : channels(channels),
+          step_samples(std::max(1, sample_rate / 10)),
+          filters(channels),
+          step_sums(channels, 0.0),
+          weights(channels, 1.0) {
+      // 5.1 in the usual order: no LFE, surrounds weighed up
+      if (channels == 6) {
+        weights = {1.0, 1.0, 1.0, 0.0, 1.41, 1.41};
+      }
+
+      auto shelf = Biquad::high_shelf(sample_rate, 1681.974450955533, 3.999843853973347, 0.7071752369554196);
+      auto high_pass = Biquad::high_pass(sample_rate, 38.13547087602444, 0.5003270373238773);
+      for (auto &filter : filters) {
+        filter = {shelf, high_pass};
+      }
+    }
+
+    template <typename T>
+    void push(const T *src, const int32_t samples, const float scale) {
+      for (int32_t i = 0; i < samples; ++i) {
+        for (int channel = 0; channel < channels; ++channel) {
+          auto &[shelf, high_pass] = filters[channel];
+          auto value = static_cast<double>(src[static_cast<size_t>(i) * channels + channel]) * scale;
+          auto weighted = high_pass.process(shelf.process(value));
+          step_sums[channel] += weighted * weighted;
+        }
+        if (++step_position == step_samples) {
+          end_step();
+        }
+      }
+    }
+
+    /* LUFS, nullopt when nothing passes the gates */
+    [[nodiscard]]
+    auto integrated() const -> std::optional<double> {
+      constexpr double absolute_gate = -70.0;
+      auto power_sum = [&](const double gate) {
+        double sum = 0;
+        size_t count = 0;
+        for (auto power : blocks) {
+          if (to_lufs(power) > gate) {
+            sum += power;
+            ++count;
+          }
+        }
+        return std::pair{sum, count};
+      };
+
+      auto [absolute_sum, absolute_count] = power_sum(absolute_gate);
+      if (absolute_count == 0) {
+        return std::nullopt;
+      }
+      auto relative_gate = to_lufs(absolute_sum / absolute_count) - 10.0;
+      auto [sum, count] = power_sum(std::max(absolute_gate, relative_gate));
+      if (count == 0) {
+        return std::nullopt;
+      }
+      return to_lufs(sum / count);
+    }
+
+   private:
+    struct Biquad {
+      double b0, b1, b2, a1, a2;
+      double z1 = 0;
+      double z2 = 0;
+
+      auto process(const double x) -> double {
+        auto y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        return y;
+      }
+
+      /* the pre-filter and RLB high-pass as BS.1770 specifies them at 48 kHz, redesigned for `rate` */
+      static auto high_shelf(const int rate, const double frequency, const double gain_db, const double q)
+          -> Biquad {
+        auto k = std::tan(Pi * frequency / rate);
+        auto high_gain = std::pow(10.0, gain_db / 20.0);
+        auto band_gain = std::pow(high_gain, 0.4996667741545416);
+        auto a0 = 1.0 + k / q + k * k;
+        return {
+            (high_gain + band_gain * k / q + k * k) / a0,
+            2.0 * (k * k - high_gain) / a0,
+            (high_gain - band_gain * k / q + k * k) / a0,
+            2.0 * (k * k - 1.0) / a0,
+            (1.0 - k / q + k * k) / a0,
+        };
+      }
+
+      static auto high_pass(const int rate, const double frequency, const double q) -> Biquad {
+        auto k = std::tan(Pi * frequency / rate);
+        auto a0 = 1.0 + k / q + k * k;
+        return {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+      }
+    };
+
+    static constexpr double Pi = 3.14159265358979323846;
+    static constexpr int StepsPerBlock = 4;
+
+    int channels;
+    int step_samples;
+    int step_position = 0;
+    std::vector<std::pair<Biquad, Biquad>> filters;
+    std::vector<double> step_sums;
+    std::vector<double> weights;
+    /* weighted power of the last steps, and of every gating block */
+    std::vector<double> steps;
+    std::vector<double> blocks;
+
+    void end_step() {
+      double power = 0;
+      for (int channel = 0; channel < channels; ++channel) {
+        power += weights[channel] * step_sums[channel] / step_samples;
+        step_sums[channel] = 0;
+      }
+      step_position = 0;
+
+      steps.push_back(power);
+      if (steps.size() > StepsPerBlock) {
+        steps.erase(steps.begin());
+      }
+      if (steps.size() == StepsPerBlock) {
+        double sum = 0;
+        for (auto step : steps) {
+          sum += step;
+        }
+        blocks.push_back(sum / StepsPerBlock);
+      }
+    }
+
+    static auto to_lufs(const double power) -> double { return -0.691 + 10.0 * std::log10(power); }
+  };
+
+  int channels;
+  int32_t length;
+  float silence_threshold;
+  std::vector<double> square_sums;
+  int buckets;
+  int64_t position = 0;
+  int64_t first_loud = -1;
+  int64_t last_loud = -1;
+  float peak = 0;
+  Analysis result;
+  std::optional<Loudness> loudness;
+};
+
+#endif  // SRC_ANALYSIS_HPP_
@@ -0,0 +1,258 @@
+#ifndef SRC_BANK_HPP_
+#define SRC_BANK_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./bank_index.hpp"
+#include "./decoder_pool.hpp"
+#include "./hash.hpp"
+#include "./streamfile.hpp"
+
+extern "C" {
+#include "vgmstream/src/vgmstream.h"
+}
+
+/* one input file: the container is parsed once and what it tells about each sub-song is kept around */
+class Bank {
+ public:
+  /* `owner` keeps the memory behind `buffer` alive for as long as the bank, when it is not held elsewhere */
+  explicit Bank(
+      const uint8_t *buffer,
+      const size_t length,
+      std::string filename,
+      std::shared_ptr<const void> owner = nullptr,
+      std::shared_ptr<Companions> companions = nullptr
+  )
+      : buffer(buffer),
+        length(length),
+        filename(std::move(filename)),
+        owner(std::move(owner)),
+        companions(std::move(companions)),
+        decoders(std::make_shared<DecoderPool>()) {}
+
+  Bank(const Bank &) = delete;
+  auto operator=(const Bank &) -> Bank & = delete;
+
+  [[nodiscard]]
+  auto name() const -> const std::string & {
+    return filename;
+  }
+
+  /* identifies a sub-song by the content of the input rather than by where it is, hashing it the first time */
+  auto content_key(const int stream_index) -> std::string {
+    char key[64];
+    snprintf(
+        key, sizeof(key), "%016llx:%zu:%d:", static_cast<unsigned long long>(hash_content()), length,
+        normalize(stream_index)
+    );
+    return key + filename;
+  }
+
+  /* whether renders may go through the render cache, which keys the main file only: not once companion files
+   * were served, which takes parsing the bank to find out */
+  auto cacheable() -> bool {
+    sub_song_count();
+    return indexable();
+  }
+
+  /* identifies the bank in the bank index: its content and its file name, which picks the parser; not the
+   * directory, so the index survives the files moving */
+  auto index_key() -> std::string {
+    char key[48];
+    snprintf(key, sizeof(key), "%016llx:%zu:", static_cast<unsigned long long>(hash_content()), length);
+    return key + Companions::basename(filename);
+  }
+
+  /* number of sub-songs, -1 when vgmstream cannot parse the file; answered by the bank index when it knows */
+  auto sub_song_count() -> int {
+    std::call_once(parsed, [&] {
+      auto bank_index = BankIndex::instance();
+      if (bank_index->enabled()) {
+        if (auto count = bank_index->sub_song_count(index_key())) {
+          stream_count = *count;
+          return;
+        }
+      }
+
+      auto vgmstream = vgmstream_from_memory(buffer, length, 0, filename, companions);
+      if (!vgmstream) {
+        return;
+      }
+      stream_count = vgmstream->num_streams;
+
+      auto index = normalize(0);
+      vgmstream_info info{};
+      describe_vgmstream_info(vgmstream.get(), &info);
+      remember(index, info);
+      decoders->release(index, {}, std::move(vgmstream));
+
+      if (bank_index->enabled() && indexable()) {
+        bank_index->record_count(index_key(), stream_count);
+      }
+    });
+    return stream_count;
+  }
+
+  /* a decoder of its own for the caller, nullptr when the sub-song cannot be opened; `setup` tells how the
+   * caller is going to set it up, a pooled decoder set up the same way (or not at all) is reused when idle;
+   * `prepared` is set when the decoder already went through that setup */
+  auto open(const int stream_index, const std::string &setup = {}, bool *prepared = nullptr)
+      -> std::shared_ptr<VGMSTREAM> {
+    auto index = normalize(stream_index);
+    auto vgmstream = decoders->acquire(index, setup);
+    if (prepared != nullptr) {
+      *prepared = vgmstream && !setup.empty();
+    }
+    if (!vgmstream && !setup.empty()) {
+      vgmstream = decoders->acquire(index, {});
+    }
+    if (vgmstream) {
+      return decoders->lend(index, setup, std::move(vgmstream));
+    }
+
+    vgmstream = vgmstream_from_memory(buffer, length, index, filename, companions);
+    if (!vgmstream) {
+      return nullptr;
+    }
+    if (!described(index)) {
+      vgmstream_info info{};
+      describe_vgmstream_info(vgmstream.get(), &info);
+      remember(index, info);
+    }
+    return decoders->lend(index, setup, std::move(vgmstream));
+  }
+
+  /* idle decoders kept for reuse, beyond which returned ones are closed */
+  void set_pool_capacity(const size_t capacity) { decoders->set_capacity(capacity); }
+
+  /* cached description of a sub-song, only parses the first time it is asked for and the bank index does not
+   * know it */
+  auto describe(const int stream_index) -> std::optional<vgmstream_info> {
+    auto index = normalize(stream_index);
+    if (auto info = recall(index)) {
+      return info;
+    }
+
+    // dropping the decoder pools it, whoever renders this sub-song next can skip the parse
+    if (!open(index)) {
+      return std::nullopt;
+    }
+
+    std::lock_guard lock(mutex);
+    return descriptors[index];
+  }
+
+  /* descriptions of every sub-song in order, nullopt for the ones that fail to open; uncached sub-songs are
+   * parsed one at a time and closed straight away, vgmstream has no way to read a header without its codec */
+  auto describe_all() -> std::vector<std::optional<vgmstream_info>> {
+    auto count = sub_song_count();
+    if (count < 0) {
+      return {};
+    }
+
+    std::vector<std::optional<vgmstream_info>> all;
+    all.reserve(std::max(count, 1));
+    for (int index = 1; index <= std::max(count, 1); ++index) {
+      if (auto info = recall(index)) {
+        all.emplace_back(std::move(info));
+        continue;
+      }
+
+      auto vgmstream = vgmstream_from_memory(buffer, length, index, filename, companions);
+      if (!vgmstream) {
+        all.emplace_back(std::nullopt);
+        continue;
+      }
+      vgmstream_info info{};
+      describe_vgmstream_info(vgmstream.get(), &info);
+      remember(index, info);
+      all.emplace_back(info);
+    }
+    return all;
+  }
+
+ private:
+  const uint8_t *buffer;
+  size_t length;
+  std::string filename;
+  std::shared_ptr<const void> owner;
+  std::shared_ptr<Companions> companions;
+
+  std::once_flag hashed;
+  uint64_t content_hash = 0;
+
+  std::once_flag parsed;
+  int stream_count = -1;
+
+  std::mutex mutex;
+  std::unordered_map<int, vgmstream_info> descriptors;
+
+  // declared last so pooled decoders close before the input they read from goes away
+  std::shared_ptr<DecoderPool> decoders;
+
+  auto hash_content() -> uint64_t {
+    std::call_once(hashed, [&] { content_hash = hash_bytes(buffer, length); });
+    return content_hash;
+  }
+
+  /* a bank parsed with the help of companion files is left out of the index, which only keys the main file */
+  [[nodiscard]]
+  auto indexable() const -> bool {
+    return !companions || !companions->served();
+  }
+
+  [[nodiscard]]
+  auto described(const int index) -> bool {
+    std::lock_guard lock(mutex);
+    return descriptors.find(index) != descriptors.end();
+  }
+
+  /* the description from this bank's cache, then from the bank index */
+  auto recall(const int index) -> std::optional<vgmstream_info> {
+    {
+      std::lock_guard lock(mutex);
+      auto found = descriptors.find(index);
+      if (found != descriptors.end()) {
+        return found->second;
+      }
+    }
+
+    auto bank_index = BankIndex::instance();
+    if (!bank_index->enabled()) {
+      return std::nullopt;
+    }
+    auto info = bank_index->describe(index_key(), index);
+    if (info) {
+      std::lock_guard lock(mutex);
+      descriptors.emplace(index, *info);
+    }
+    return info;
+  }
+
+  /* caches a fresh description, and writes it to the bank index */
+  void remember(const int index, const vgmstream_info &info) {
+    {
+      std::lock_guard lock(mutex);
+      descriptors.emplace(index, info);
+    }
+    auto bank_index = BankIndex::instance();
+    if (bank_index->enabled() && indexable()) {
+      bank_index->record_info(index_key(), index, info);
+    }
+  }
+
+  /* 0 asks vgmstream for the default sub-song, which is the first one */
+  static auto normalize(const int stream_index) -> int { return stream_index <= 0 ? 1 : stream_index; }
+};
+
+#endif  // SRC_BANK_HPP_
@@ -0,0 +1,360 @@
+#ifndef SRC_BANK_INDEX_HPP_
+#define SRC_BANK_INDEX_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "./hash.hpp"
+
+extern "C" {
+#include "vgmstream/src/vgmstream.h"
+#include "vgmstream/version.h"
+}
+
+/* what parsing banks told about them, kept in a file so a restarted process answers sub-song counts and
+ * descriptions without parsing again: checksummed records appended behind a header naming the vgmstream
+ * version, read whole when configured; disabled until given a path */
+class BankIndex {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t appends = 0;
+    size_t banks = 0;
+    size_t sub_songs = 0;
+  };
+
+  explicit BankIndex(std::string path = {}) : path(std::move(path)) {
+    if (!this->path.empty()) {
+      load();
+    }
+  }
+
+  BankIndex(const BankIndex &) = delete;
+  auto operator=(const BankIndex &) -> BankIndex & = delete;
+
+  ~BankIndex() {
+    if (fd >= 0) {
+      close_file(fd);
+    }
+  }
+
+  [[nodiscard]]
+  auto enabled() const -> bool {
+    return fd >= 0;
+  }
+
+  [[nodiscard]]
+  auto file_path() const -> const std::string & {
+    return path;
+  }
+
+  /* `key` names the bank by its content, see Bank::index_key() */
+  auto sub_song_count(const std::string &key) -> std::optional<int> {
+    std::lock_guard lock(mutex);
+    auto found = entries.find(key);
+    if (found == entries.end() || found->second.count < 0) {
+      ++counters.misses;
+      return std::nullopt;
+    }
+    ++counters.hits;
+    return found->second.count;
+  }
+
+  auto describe(const std::string &key, const int stream_index) -> std::optional<vgmstream_info> {
+    std::lock_guard lock(mutex);
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+      auto info = found->second.infos.find(stream_index);
+      if (info != found->second.infos.end()) {
+        ++counters.hits;
+        return info->second;
+      }
+    }
+    ++counters.misses;
+    return std::nullopt;
+  }
+
+  /* what is already known is not written again */
+  void record_count(const std::string &key, const int count) {
+    std::lock_guard lock(mutex);
+    auto &entry = entries[key];
+    if (entry.count == count) {
+      return;
+    }
+    entry.count = count;
+    append(encode(Kind::Count, key, count, nullptr));
+  }
+
+  void record_info(const std::string &key, const int stream_index, const vgmstream_info &info) {
+    std::lock_guard lock(mutex);
+    auto &infos = entries[key].infos;
+    if (!infos.emplace(stream_index, info).second) {
+      return;
+    }
+    append(encode(Kind::Info, key, stream_index, &info));
+  }
+
+  [[nodiscard]]
+  auto stats() -> Stats {
+    std::lock_guard lock(mutex);
+    auto stats = counters;
+    stats.banks = entries.size();
+    stats.sub_songs = 0;
+    for (const auto &[key, entry] : entries) {
+      stats.sub_songs += entry.infos.size();
+    }
+    return stats;
+  }
+
+  /* process-wide index shared by every bank */
+  static auto instance() -> std::shared_ptr<BankIndex> {
+    std::lock_guard lock(shared_mutex());
+    auto &index = shared_index();
+    if (!index) {
+      index = std::make_shared<BankIndex>();
+    }
+    return index;
+  }
+
+  /* loads the index at `path`, or disables it when empty; banks already parsed keep what they know */
+  static void configure(const std::string &path) {
+    auto index = std::make_shared<BankIndex>(path);
+    std::lock_guard lock(shared_mutex());
+    shared_index().swap(index);
+  }
+
+ private:
+  enum class Kind : uint8_t { Count = 1, Info = 2 };
+
+  /* bumped whenever the record layout changes */
+  static constexpr uint32_t FormatVersion = 1;
+
+  struct Entry {
+    int count = -1;
+    std::unordered_map<int, vgmstream_info> infos;
+  };
+
+  const std::string path;
+  /* opened for appending, each record goes out in a single write() */
+  int fd = -1;
+
+  std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+  Stats counters;
+
+  /* magic, format version and vgmstream_info size (which also tell the byte order apart), then the vgmstream
+   * version: a mismatch in any of them makes the whole file stale */
+  static auto header() -> std::string {
+    std::string header = "VGMI";
+    auto info_size = static_cast<uint32_t>(sizeof(vgmstream_info));
+    auto version = std::string(VGMSTREAM_VERSION);
+    auto version_length = static_cast<uint16_t>(version.size());
+    header.append(reinterpret_cast<const char *>(&FormatVersion), sizeof(FormatVersion));
+    header.append(reinterpret_cast<const char *>(&info_size), sizeof(info_size));
+    header.append(reinterpret_cast<const char *>(&version_length), sizeof(version_length));
+    return header + version;
+  }
+
+  /* payload length and checksum, then the kind, the key, the count or 1-based sub-song and the description */
+  static auto encode(const Kind kind, const std::string &key, const int32_t value, const vgmstream_info *info)
+      -> std::string {
+    std::string payload;
+    auto key_length = static_cast<uint16_t>(std::min<size_t>(key.size(), UINT16_MAX));
+    payload.push_back(static_cast<char>(kind));
+    payload.append(reinterpret_cast<const char *>(&key_length), sizeof(key_length));
+    payload.append(key, 0, key_length);
+    payload.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    if (info != nullptr) {
+      payload.append(reinterpret_cast<const char *>(info), sizeof(*info));
+    }
+
+    auto length = static_cast<uint32_t>(payload.size());
+    auto checksum = hash_string(payload);
+    std::string record;
+    record.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    record.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+    return record + payload;
+  }
+
+  /* applies the record at `offset`, returns where the next one starts or nullopt when it is torn or corrupt */
+  auto decode(const std::string &contents, const size_t offset) -> std::optional<size_t> {
+    uint32_t length = 0;
+    uint64_t checksum = 0;
+    constexpr auto prefix = sizeof(length) + sizeof(checksum);
+    if (contents.size() - offset < prefix) {
+      return std::nullopt;
+    }
+    memcpy(&length, contents.data() + offset, sizeof(length));
+    memcpy(&checksum, contents.data() + offset + sizeof(length), sizeof(checksum));
+    if (contents.size() - offset - prefix < length) {
+      return std::nullopt;
+    }
+    auto payload = contents.substr(offset + prefix, length);
+    if (hash_string(payload) != checksum) {
+      return std::nullopt;
+    }
+
+    uint16_t key_length = 0;
+    int32_t value = 0;
+    if (payload.size() < 1 + sizeof(key_length)) {
+      return std::nullopt;
+    }
+    auto kind = static_cast<Kind>(payload[0]);
+    memcpy(&key_length, payload.data() + 1, sizeof(key_length));
+    auto value_offset = 1 + sizeof(key_length) + key_length;
+    auto expected = value_offset + sizeof(value) + (kind == Kind::Info ? sizeof(vgmstream_info) : 0);
+    if ((kind != Kind::Count && kind != Kind::Info) || payload.size() != expected) {
+      return std::nullopt;
+    }
+    memcpy(&value, payload.data() + value_offset, sizeof(value));
+
+    auto &entry = entries[payload.substr(1 + sizeof(key_length), key_length)];
+    if (kind == Kind::Count) {
+      entry.count = value;
+    } else {
+      vgmstream_info info{};
+      memcpy(&info, payload.data() + value_offset + sizeof(value), sizeof(info));
+      entry.infos[value] = info;
+    }
+    return offset + prefix + length;
+  }
+
+  void load() {
+    std::string contents;
+    if (auto *input = fopen(path.c_str(), "rb")) {
+      char chunk[65536];
+      size_t read = 0;
+      while ((read = fread(chunk, 1, sizeof(chunk), input)) > 0) {
+        contents.append(chunk, read);
+      }
+      fclose(input);
+    }
+
+    auto expected = header();
+    auto intact = contents.size() >= expected.size() && contents.compare(0, expected.size(), expected) == 0;
+    if (intact) {
+      for (size_t offset = expected.size(); offset < contents.size();) {
+        auto next = decode(contents, offset);
+        if (!next) {
+          intact = false;
+          break;
+        }
+        offset = *next;
+      }
+    }
+    if (intact) {
+      fd = open_append(path);
+      return;
+    }
+
+    // another vgmstream or a record torn by a crash: start over with whatever could be read
+    rewrite(expected);
+  }
+
+  /* writes a fresh file next to the index and renames it over, so processes appending to the old one never
+   * see it truncated; what they append until they reload is lost, and gets recorded again by whoever parses
+   * those banks next */
+  void rewrite(const std::string &expected) {
+    std::string contents = expected;
+    for (const auto &[key, entry] : entries) {
+      if (entry.count >= 0) {
+        contents += encode(Kind::Count, key, entry.count, nullptr);
+      }
+      for (const auto &[stream_index, info] : entry.infos) {
+        contents += encode(Kind::Info, key, stream_index, &info);
+      }
+    }
+
+    char suffix[24];
+    std::random_device random;
+    snprintf(suffix, sizeof(suffix), ".%08x.tmp", static_cast<unsigned>(random()));
+    auto temporary = path + suffix;
+    auto *output = fopen(temporary.c_str(), "wb");
+    if (output == nullptr) {
+      return;
+    }
+    auto written = fwrite(contents.data(), 1, contents.size(), output) == contents.size();
+    if (fclose(output) != 0 || !written || !replace_file(temporary, path)) {
+      remove(temporary.c_str());
+      return;
+    }
+    fd = open_append(path);
+  }
+
+  /* one write per record on an O_APPEND descriptor, so processes sharing the file interleave whole records; a
+   * short write leaves a torn record, which the next load drops */
+  void append(const std::string &record) {
+    if (fd < 0) {
+      return;
+    }
+#ifdef _WIN32
+    auto written = _write(fd, record.data(), static_cast<unsigned>(record.size()));
+#else
+    auto written = ::write(fd, record.data(), record.size());
+#endif
+    if (written == static_cast<decltype(written)>(record.size())) {
+      ++counters.appends;
+    }
+  }
+
+  static auto open_append(const std::string &path) -> int {
+#ifdef _WIN32
+    return _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+  }
+
+  static void close_file(const int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+  }
+
+  /* atomically on POSIX, where rename() replaces the target; Windows needs to be told to */
+  static auto replace_file(const std::string &from, const std::string &to) -> bool {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+  }
+
+  static auto shared_mutex() -> std::mutex & {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static auto shared_index() -> std::shared_ptr<BankIndex> & {
+    static std::shared_ptr<BankIndex> index;
+    return index;
+  }
+};
+
+#endif  // SRC_BANK_INDEX_HPP_
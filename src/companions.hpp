@@ -0,0 +1,88 @@
+#ifndef SRC_COMPANIONS_HPP_
+#define SRC_COMPANIONS_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "./mapped_file.hpp"
+
+/* bytes owned by someone else */
+struct MemoryView {
+  const uint8_t *data;
+  size_t length;
+};
+
+/* sidecar files a format may ask for next to the one being parsed (.txth, .sfd headers, split channels...),
+ * served from named buffers first, then mapped from a directory; lookups are cached, misses included */
+class Companions {
+ public:
+  explicit Companions(std::unordered_map<std::string, MemoryView> files, std::string directory)
+      : files(std::move(files)), directory(std::move(directory)) {}
+
+  Companions(const Companions &) = delete;
+  auto operator=(const Companions &) -> Companions & = delete;
+
+  /* `name` is whatever vgmstream built from the main file's name, usually with its directory in front */
+  auto resolve(const std::string &name) -> std::optional<MemoryView> {
+    auto base = basename(name);
+    for (const auto &key : {name, base}) {
+      auto found = files.find(key);
+      if (found != files.end()) {
+        used.store(true, std::memory_order_relaxed);
+        return found->second;
+      }
+    }
+    if (directory.empty()) {
+      return std::nullopt;
+    }
+
+    std::lock_guard lock(mutex);
+    auto cached = mapped.find(base);
+    if (cached == mapped.end()) {
+      auto separated = directory.back() == '/' || directory.back() == '\\';
+      cached = mapped.emplace(base, MappedFile::open(separated ? directory + base : directory + "/" + base)).first;
+    }
+    if (!cached->second) {
+      return std::nullopt;
+    }
+    used.store(true, std::memory_order_relaxed);
+    return MemoryView{cached->second->data(), cached->second->size()};
+  }
+
+  /* whether any file was served, which makes what was parsed depend on more than the main file */
+  [[nodiscard]]
+  auto served() const -> bool {
+    return used.load(std::memory_order_relaxed);
+  }
+
+  /* directory part of `path`: "." for a bare name, the root itself for a file right under it */
+  static auto dirname(const std::string &path) -> std::string {
+    auto separator = path.find_last_of("/\\");
+    if (separator == std::string::npos) {
+      return ".";
+    }
+    return path.substr(0, separator == 0 ? 1 : separator);
+  }
+
+  static auto basename(const std::string &path) -> std::string {
+    auto separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+  }
+
+ private:
+  const std::unordered_map<std::string, MemoryView> files;
+  const std::string directory;
+
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<MappedFile>> mapped;
+  std::atomic<bool> used{false};
+};
+
+#endif  // SRC_COMPANIONS_HPP_
@@ -0,0 +1,99 @@
+#ifndef SRC_DECODER_POOL_HPP_
+#define SRC_DECODER_POOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "vgmstream/src/vgmstream.h"
+}
+
+/* idle decoders of one bank, kept by sub-song and by the setup (play config...) applied to them, so renders
+ * of the same sub-song skip the parse and codec setup; a decoder is only ever used by one borrower at a time */
+class DecoderPool : public std::enable_shared_from_this<DecoderPool> {
+ public:
+  static constexpr size_t DefaultCapacity = 4;
+
+  explicit DecoderPool(const size_t capacity = DefaultCapacity) : capacity(capacity) {}
+
+  DecoderPool(const DecoderPool &) = delete;
+  auto operator=(const DecoderPool &) -> DecoderPool & = delete;
+
+  /* an idle decoder of `index` rewound to its start, nullptr when there is none */
+  auto acquire(const int index, const std::string &setup) -> std::shared_ptr<VGMSTREAM> {
+    std::shared_ptr<VGMSTREAM> vgmstream;
+    {
+      std::lock_guard lock(mutex);
+      for (auto it = idle.begin(); it != idle.end(); ++it) {
+        if (it->index == index && it->setup == setup) {
+          vgmstream = std::move(it->vgmstream);
+          idle.erase(it);
+          break;
+        }
+      }
+    }
+    if (vgmstream) {
+      reset_vgmstream(vgmstream.get());
+    }
+    return vgmstream;
+  }
+
+  /* hands `vgmstream` out, it comes back here under `setup` instead of closing once the borrower is done */
+  auto lend(const int index, const std::string &setup, std::shared_ptr<VGMSTREAM> vgmstream)
+      -> std::shared_ptr<VGMSTREAM> {
+    auto *raw = vgmstream.get();
+    return std::shared_ptr<VGMSTREAM>(
+        raw, [pool = weak_from_this(), index, setup, vgmstream = std::move(vgmstream)](auto ptr) mutable {
+          if (auto owner = pool.lock()) {
+            owner->release(index, setup, std::move(vgmstream));
+          }
+        }
+    );
+  }
+
+  /* keeps `vgmstream` for later, unless the pool is full */
+  void release(const int index, const std::string &setup, std::shared_ptr<VGMSTREAM> vgmstream) {
+    {
+      std::lock_guard lock(mutex);
+      if (idle.size() < capacity) {
+        idle.push_back({index, setup, std::move(vgmstream)});
+        return;
+      }
+    }
+    // a full pool closes it on the way out, outside of the lock
+  }
+
+  void set_capacity(const size_t new_capacity) {
+    // declared first so the evicted decoders close after the lock is released
+    std::vector<Idle> dropped;
+    std::lock_guard lock(mutex);
+    capacity = new_capacity;
+    while (idle.size() > capacity) {
+      dropped.push_back(std::move(idle.front()));
+      idle.erase(idle.begin());
+    }
+  }
+
+  [[nodiscard]]
+  auto idle_count() -> size_t {
+    std::lock_guard lock(mutex);
+    return idle.size();
+  }
+
+ private:
+  struct Idle {
+    int index;
+    std::string setup;
+    std::shared_ptr<VGMSTREAM> vgmstream;
+  };
+
+  std::mutex mutex;
+  size_t capacity;
+  std::vector<Idle> idle;
+};
+
+#endif  // SRC_DECODER_POOL_HPP_
@@ -0,0 +1,25 @@
+#ifndef SRC_ENDIAN_HPP_
+#define SRC_ENDIAN_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#define SWAP_REQUIRED true
+#else
+#define SWAP_REQUIRED false
+#endif
+
+/* reverses the bytes of `count` values of T in place */
+template <typename T>
+void swap_bytes(T *values, const size_t count) {
+  auto *bytes = reinterpret_cast<uint8_t *>(values);
+  for (auto *i = bytes; i < bytes + count * sizeof(T); i += sizeof(T)) {
+    for (auto *left_ptr = i, *right_ptr = i + sizeof(T) - 1; left_ptr < right_ptr; ++left_ptr, --right_ptr) {
+      std::swap(*left_ptr, *right_ptr);
+    }
+  }
+}
+
+#endif  // SRC_ENDIAN_HPP_
@@ -0,0 +1,415 @@
+#ifndef SRC_FLAC_ENCODER_HPP_
+#define SRC_FLAC_ENCODER_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+#include "vgmstream/src/streamtypes.h"
+}
+
+/* MSB-first bit packing into a byte vector */
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t> &out) : out(out) {}
+
+  /* the low `bits` bits of value, at most 32 */
+  void write(const uint32_t value, const int bits) {
+    if (bits == 0) {
+      return;
+    }
+    accumulator = (accumulator << bits) | (value & (bits == 32 ? 0xFFFFFFFFU : (1U << bits) - 1));
+    pending += bits;
+    while (pending >= 8) {
+      pending -= 8;
+      out.push_back(static_cast<uint8_t>(accumulator >> pending));
+    }
+  }
+
+  void write_signed(const int32_t value, const int bits) { write(static_cast<uint32_t>(value), bits); }
+
+  /* `zeros` zero bits then a one */
+  void write_unary(uint32_t zeros) {
+    for (; zeros >= 32; zeros -= 32) {
+      write(0, 32);
+    }
+    write(1, static_cast<int>(zeros) + 1);
+  }
+
+  void write_rice(const int32_t value, const int parameter) {
+    auto folded = fold(value);
+    write_unary(folded >> parameter);
+    write(folded, parameter);
+  }
+
+  /* pads with zero bits to the next byte */
+  void align() {
+    if (pending > 0) {
+      write(0, 8 - pending);
+    }
+  }
+
+  /* zigzag, so small magnitudes of either sign get short codes */
+  static auto fold(const int32_t value) -> uint32_t {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  }
+
+ private:
+  std::vector<uint8_t> &out;
+  uint64_t accumulator = 0;
+  int pending = 0;
+};
+
+/* 16-bit FLAC from interleaved int16 blocks, fed incrementally: the stream header goes first, then frames of
+ * BlockSize samples come out as soon as enough are pushed and finish() flushes the shorter last one; each
+ * channel is coded with the best of the fixed predictors and partitioned Rice residuals, stereo tries the
+ * side-channel modes too */
+class FlacEncoder {
+ public:
+  static constexpr int BlockSize = 4096;
+  static constexpr int MaxChannels = 8;
+  static constexpr int MaxPartitionOrder = 8;
+
+  /* `total_samples` per channel goes into the header, 0 when unknown */
+  FlacEncoder(const int channels, const int sample_rate, const int64_t total_samples)
+      : channels(channels), sample_rate(sample_rate), total_samples(total_samples), planes(channels) {
+    for (auto &plane : planes) {
+      plane.resize(BlockSize);
+    }
+    for (auto &candidate : candidates) {
+      candidate.resize(BlockSize);
+    }
+    residual.resize(BlockSize);
+  }
+
+  /* "fLaC" and the STREAMINFO block; frame sizes and the MD5 signature are left as unknown, which the format
+   * allows, so the header never has to be patched once written */
+  void write_header(std::vector<uint8_t> &out) const {
+    BitWriter writer(out);
+    for (auto byte : {'f', 'L', 'a', 'C'}) {
+      writer.write(static_cast<uint8_t>(byte), 8);
+    }
+    writer.write(1, 1);  // last metadata block
+    writer.write(0, 7);  // STREAMINFO
+    writer.write(34, 24);
+    writer.write(BlockSize, 16);
+    writer.write(BlockSize, 16);
+    writer.write(0, 24);
+    writer.write(0, 24);
+    writer.write(static_cast<uint32_t>(sample_rate), 20);
+    writer.write(static_cast<uint32_t>(channels - 1), 3);
+    writer.write(BitsPerSample - 1, 5);
+    writer.write(static_cast<uint32_t>(static_cast<uint64_t>(total_samples) >> 32), 4);
+    writer.write(static_cast<uint32_t>(total_samples), 32);
+    for (int i = 0; i < 4; ++i) {
+      writer.write(0, 32);
+    }
+  }
+
+  /* encodes every full frame `samples` more samples per channel complete */
+  void push(const sample_t *src, const int32_t samples, std::vector<uint8_t> &out) {
+    for (int32_t done = 0; done < samples;) {
+      auto count = std::min(samples - done, BlockSize - buffered);
+      for (int channel = 0; channel < channels; ++channel) {
+        auto *plane = planes[channel].data() + buffered;
+        for (int32_t i = 0; i < count; ++i) {
+          plane[i] = src[(done + i) * channels + channel];
+        }
+      }
+      buffered += count;
+      done += count;
+      if (buffered == BlockSize) {
+        encode_frame(out);
+      }
+    }
+  }
+
+  /* encodes what is left as the last frame */
+  void finish(std::vector<uint8_t> &out) {
+    if (buffered > 0) {
+      encode_frame(out);
+    }
+  }
+
+ private:
+  static constexpr int BitsPerSample = 16;
+
+  enum class Stereo { Independent = 1, LeftSide = 8, SideRight = 9, MidSide = 10 };
+
+  struct Subframe {
+    enum class Type { Constant, Verbatim, Fixed } type = Type::Verbatim;
+    int order = 0;
+    int partition_order = 0;
+    std::array<int, 1 << MaxPartitionOrder> parameters{};
+    uint64_t bits = 0;
+  };
+
+  int channels;
+  int sample_rate;
+  int64_t total_samples;
+  std::vector<std::vector<int32_t>> planes;
+  /* mid and side of a stereo frame */
+  std::array<std::vector<int32_t>, 2> candidates;
+  std::vector<int32_t> residual;
+  int32_t buffered = 0;
+  uint64_t frame_number = 0;
+
+  void encode_frame(std::vector<uint8_t> &out) {
+    auto start = out.size();
+    auto samples = buffered;
+
+    std::vector<const int32_t *> sources;
+    std::vector<int> widths;
+    auto assignment = Stereo::Independent;
+    std::vector<Subframe> plans;
+    if (channels == 2) {
+      auto *mid = candidates[0].data();
+      auto *side = candidates[1].data();
+      for (int32_t i = 0; i < samples; ++i) {
+        mid[i] = (planes[0][i] + planes[1][i]) >> 1;
+        side[i] = planes[0][i] - planes[1][i];
+      }
+      auto left_plan = plan(planes[0].data(), samples, BitsPerSample);
+      auto right_plan = plan(planes[1].data(), samples, BitsPerSample);
+      auto mid_plan = plan(mid, samples, BitsPerSample);
+      auto side_plan = plan(side, samples, BitsPerSample + 1);
+
+      auto best = left_plan.bits + right_plan.bits;
+      sources = {planes[0].data(), planes[1].data()};
+      widths = {BitsPerSample, BitsPerSample};
+      plans = {left_plan, right_plan};
+      if (left_plan.bits + side_plan.bits < best) {
+        best = left_plan.bits + side_plan.bits;
+        assignment = Stereo::LeftSide;
+        sources = {planes[0].data(), side};
+        widths = {BitsPerSample, BitsPerSample + 1};
+        plans = {left_plan, side_plan};
+      }
+      if (side_plan.bits + right_plan.bits < best) {
+        best = side_plan.bits + right_plan.bits;
+        assignment = Stereo::SideRight;
+        sources = {side, planes[1].data()};
+        widths = {BitsPerSample + 1, BitsPerSample};
+        plans = {side_plan, right_plan};
+      }
+      if (mid_plan.bits + side_plan.bits < best) {
+        assignment = Stereo::MidSide;
+        sources = {mid, side};
+        widths = {BitsPerSample, BitsPerSample + 1};
+        plans = {mid_plan, side_plan};
+      }
+    } else {
+      for (int channel = 0; channel < channels; ++channel) {
+        sources.push_back(planes[channel].data());
+        widths.push_back(BitsPerSample);
+        plans.push_back(plan(planes[channel].data(), samples, BitsPerSample));
+      }
+    }
+
+    BitWriter writer(out);
+    writer.write(0xFFF8, 16);  // sync code, fixed block size
+    auto size_code = samples == BlockSize ? 12 : 7;
+    writer.write(size_code, 4);
+    writer.write(0, 4);  // sample rate from STREAMINFO
+    writer.write(
+        assignment == Stereo::Independent ? static_cast<uint32_t>(channels - 1) : static_cast<uint32_t>(assignment),
+        4
+    );
+    writer.write(4, 3);  // 16 bits per sample
+    writer.write(0, 1);
+    write_utf8(writer, frame_number++);
+    if (size_code == 7) {
+      writer.write(static_cast<uint32_t>(samples - 1), 16);
+    }
+    writer.write(crc8(out.data() + start, out.size() - start), 8);
+
+    for (size_t channel = 0; channel < sources.size(); ++channel) {
+      write_subframe(writer, sources[channel], samples, widths[channel], plans[channel]);
+    }
+    writer.align();
+    auto crc = crc16(out.data() + start, out.size() - start);
+    writer.write(crc, 16);
+
+    buffered = 0;
+  }
+
+  /* picks how to code one channel and what it costs in bits, without writing anything */
+  auto plan(const int32_t *samples, const int32_t count, const int bits) -> Subframe {
+    Subframe subframe;
+    subframe.bits = 8 + static_cast<uint64_t>(count) * bits;
+
+    if (std::all_of(samples, samples + count, [&](auto sample) { return sample == samples[0]; })) {
+      subframe.type = Subframe::Type::Constant;
+      subframe.bits = 8 + bits;
+      return subframe;
+    }
+
+    // the order with the smallest residual magnitude, as a cheap stand-in for the smallest coded size
+    auto best_order = 0;
+    uint64_t best_sum = UINT64_MAX;
+    for (int order = 0; order <= 4 && order < count; ++order) {
+      uint64_t sum = 0;
+      for (int32_t i = order; i < count; ++i) {
+        sum += static_cast<uint64_t>(std::abs(predict_residual(samples, i, order)));
+      }
+      if (sum < best_sum) {
+        best_sum = sum;
+        best_order = order;
+      }
+    }
+
+    for (int32_t i = best_order; i < count; ++i) {
+      residual[i] = predict_residual(samples, i, best_order);
+    }
+    Subframe fixed;
+    fixed.type = Subframe::Type::Fixed;
+    fixed.order = best_order;
+    fixed.bits = 8 + static_cast<uint64_t>(best_order) * bits + 6 + plan_partitions(count, best_order, fixed);
+    return fixed.bits < subframe.bits ? fixed : subframe;
+  }
+
+  /* the cheapest Rice partitioning of the residual, returns its size in bits */
+  auto plan_partitions(const int32_t count, const int order, Subframe &subframe) const -> uint64_t {
+    uint64_t best = UINT64_MAX;
+    std::array<int, 1 << MaxPartitionOrder> parameters{};
+    for (int partition_order = 0; partition_order <= MaxPartitionOrder; ++partition_order) {
+      auto partitions = 1 << partition_order;
+      if (count % partitions != 0 || (count >> partition_order) <= order) {
+        break;
+      }
+      uint64_t total = 0;
+      auto partition_size = count >> partition_order;
+      for (int partition = 0; partition < partitions; ++partition) {
+        auto begin = partition == 0 ? order : partition * partition_size;
+        auto end = (partition + 1) * partition_size;
+        uint64_t sum = 0;
+        for (int32_t i = begin; i < end; ++i) {
+          sum += BitWriter::fold(residual[i]);
+        }
+        auto [parameter, bits] = rice_parameter(sum, end - begin);
+        parameters[partition] = parameter;
+        total += 4 + bits;
+      }
+      if (total < best) {
+        best = total;
+        subframe.partition_order = partition_order;
+        subframe.parameters = parameters;
+      }
+    }
+    return best;
+  }
+
+  /* the parameter around log2 of the mean that codes `count` values summing to `sum` the shortest, in an
+   * estimate exact enough to pick it: each value costs parameter + 1 bits plus its quotient */
+  static auto rice_parameter(const uint64_t sum, const int32_t count) -> std::pair<int, uint64_t> {
+    auto best = std::pair<int, uint64_t>{0, UINT64_MAX};
+    for (int parameter = 0; parameter <= 14; ++parameter) {
+      auto bits = static_cast<uint64_t>(count) * (parameter + 1) + (sum >> parameter);
+      if (bits < best.second) {
+        best = {parameter, bits};
+      }
+    }
+    return best;
+  }
+
+  void write_subframe(BitWriter &writer, const int32_t *samples, const int32_t count, const int bits,
+                      const Subframe &subframe) {
+    writer.write(0, 1);
+    switch (subframe.type) {
+      case Subframe::Type::Constant:
+        writer.write(0, 6);
+        writer.write(0, 1);
+        writer.write_signed(samples[0], bits);
+        return;
+      case Subframe::Type::Verbatim:
+        writer.write(1, 6);
+        writer.write(0, 1);
+        for (int32_t i = 0; i < count; ++i) {
+          writer.write_signed(samples[i], bits);
+        }
+        return;
+      case Subframe::Type::Fixed:
+        break;
+    }
+
+    auto order = subframe.order;
+    writer.write(8 | order, 6);
+    writer.write(0, 1);
+    for (int i = 0; i < order; ++i) {
+      writer.write_signed(samples[i], bits);
+    }
+    writer.write(0, 2);  // Rice with 4-bit parameters
+    writer.write(subframe.partition_order, 4);
+    auto partitions = 1 << subframe.partition_order;
+    auto partition_size = count >> subframe.partition_order;
+    for (int partition = 0; partition < partitions; ++partition) {
+      auto parameter = subframe.parameters[partition];
+      writer.write(parameter, 4);
+      auto begin = partition == 0 ? order : partition * partition_size;
+      auto end = (partition + 1) * partition_size;
+      for (int32_t i = begin; i < end; ++i) {
+        writer.write_rice(predict_residual(samples, i, order), parameter);
+      }
+    }
+  }
+
+  /* what the fixed polynomial predictor of `order` misses at sample i */
+  static auto predict_residual(const int32_t *samples, const int32_t i, const int order) -> int32_t {
+    switch (order) {
+      case 0:
+        return samples[i];
+      case 1:
+        return samples[i] - samples[i - 1];
+      case 2:
+        return samples[i] - 2 * samples[i - 1] + samples[i - 2];
+      case 3:
+        return samples[i] - 3 * samples[i - 1] + 3 * samples[i - 2] - samples[i - 3];
+      default:
+        return samples[i] - 4 * samples[i - 1] + 6 * samples[i - 2] - 4 * samples[i - 3] + samples[i - 4];
+    }
+  }
+
+  static void write_utf8(BitWriter &writer, const uint64_t value) {
+    if (value < 0x80) {
+      writer.write(static_cast<uint32_t>(value), 8);
+      return;
+    }
+    auto continuation = 1;
+    while (continuation < 6 && value >= (1ULL << (5 * continuation + 6))) {
+      ++continuation;
+    }
+    auto lead_marker = (0xFF00U >> (continuation + 1)) & 0xFFU;
+    writer.write(lead_marker | static_cast<uint32_t>(value >> (6 * continuation)), 8);
+    for (int i = continuation - 1; i >= 0; --i) {
+      writer.write(0x80 | static_cast<uint32_t>((value >> (6 * i)) & 0x3F), 8);
+    }
+  }
+
+  static auto crc8(const uint8_t *data, const size_t length) -> uint8_t {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; ++i) {
+      crc ^= data[i];
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 0x80) != 0 ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+      }
+    }
+    return crc;
+  }
+
+  static auto crc16(const uint8_t *data, const size_t length) -> uint16_t {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; ++i) {
+      crc ^= static_cast<uint16_t>(data[i] << 8);
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 0x8000) != 0 ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+      }
+    }
+    return crc;
+  }
+};
+
+#endif  // SRC_FLAC_ENCODER_HPP_
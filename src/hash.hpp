@@ -0,0 +1,42 @@
+#ifndef SRC_HASH_HPP_
+#define SRC_HASH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/* 64-bit non-cryptographic hash, eight bytes per step so hashing a whole bank stays far cheaper than
+ * decoding it; for cache keys and file names, not for anything adversarial */
+inline auto hash_bytes(const uint8_t *data, const size_t length, uint64_t seed = 0) -> uint64_t {
+  constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+  auto hash = seed ^ (length * multiplier);
+
+  auto mix = [&](uint64_t word) {
+    word *= 0xBF58476D1CE4E5B9ULL;
+    word ^= word >> 31;
+    hash = (hash ^ word) * multiplier;
+    hash ^= hash >> 29;
+  };
+
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    mix(word);
+  }
+  if (i < length) {
+    uint64_t word = 0;
+    memcpy(&word, data + i, length - i);
+    mix(word);
+  }
+
+  hash ^= hash >> 32;
+  return hash;
+}
+
+inline auto hash_string(const std::string &string) -> uint64_t {
+  return hash_bytes(reinterpret_cast<const uint8_t *>(string.data()), string.size());
+}
+
+#endif  // SRC_HASH_HPP_
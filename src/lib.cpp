@@ -1,45 +1,676 @@
 #include <napi.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "./bank.hpp"
+#include "./mapped_file.hpp"
+#include "./memory_budget.hpp"
+#include "./render.hpp"
+#include "./render_cache.hpp"
+#include "./stats.hpp"
 #include "./utils.hpp"
 
 extern "C" {
-#include "vgmstream/cli/wav_utils.h"
 #include "vgmstream/src/base/plugins.h"
 #include "vgmstream/src/streamtypes.h"
 #include "vgmstream/src/vgmstream.h"
 #include "vgmstream/version.h"
 }
 
+using BufferRef = Napi::Reference<Napi::Object>;
+
+/* what sub-songs and readers share with the VGMStream they were selected from */
+struct BankHandle {
+  std::shared_ptr<Bank> bank;
+  std::shared_ptr<BufferRef> buffer_ref;
+
+  static auto from_buffer(
+      const NapiBuffer &buffer, const std::string &filename, std::shared_ptr<Companions> companions = nullptr
+  ) -> BankHandle {
+    return BankHandle{
+        std::make_shared<Bank>(buffer.Data(), buffer.Length(), filename, nullptr, std::move(companions)),
+        std::make_shared<BufferRef>(std::move(BufferRef::New(buffer, 1))),
+    };
+  }
+
+  /* maps the file at `path`, the bank then owns its input and there is no buffer to pin; no bank on failure */
+  static auto from_file(
+      const std::string &path, const std::string &filename, std::shared_ptr<Companions> companions = nullptr
+  ) -> BankHandle {
+    auto file = MappedFile::open(path);
+    if (!file) {
+      return {};
+    }
+    auto bank = std::make_shared<Bank>(file->data(), file->size(), filename, file, std::move(companions));
+    return BankHandle{std::move(bank), nullptr};
+  }
+
+  /* pins `buffers` (companion files) for as long as the input */
+  void pin(Napi::Array buffers) {
+    if (buffers.Length() == 0) {
+      return;
+    }
+    if (this->buffer_ref) {
+      buffers.Set(buffers.Length(), this->buffer_ref->Value());
+    }
+    this->buffer_ref = std::make_shared<BufferRef>(BufferRef::New(buffers, 1));
+  }
+
+  static auto from_arg(const Napi::Value &arg) -> BankHandle { return *arg.As<Napi::External<BankHandle>>().Data(); }
+
+  /* keeps the input buffer (if any) alive until `promise` is collected */
+  void retain(Napi::Promise &promise) const {
+    if (!this->buffer_ref) {
+      return;
+    }
+    this->buffer_ref->Ref();
+
+    auto finalizer = [buffer_ref = buffer_ref](Napi::Env env, void *data) { buffer_ref->Unref(); };
+    promise.AddFinalizer<decltype(finalizer), void>(finalizer, nullptr);
+  }
+};
+
+constexpr auto OpenFailure = "failed to open the sub-song";
+constexpr auto FlacChannelFailure = "flac output holds at most 8 channels, select or downmix some";
+/* a waveform far wider than any display, about 8 MB of min/max pairs */
+constexpr int MaxPeakBuckets = 1 << 20;
+
+/* an array of 0-based indices under 32 as a bit mask, 0 when the option is absent; leaves a pending JS
+ * exception when it is not such an array */
+auto obtain_index_mask(const Napi::Object &options, const char *name) -> uint32_t {
+  auto env = options.Env();
+  auto indices = obtain_option<Napi::Array>(options, name);
+  if (!indices) {
+    return 0;
+  }
+
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < indices->Length(); ++i) {
+    Napi::Value index = indices->Get(i);
+    auto value = index.IsNumber() ? index.As<Napi::Number>().DoubleValue() : -1;
+    if (value < 0 || value >= 32 || value != static_cast<int>(value)) {
+      Napi::RangeError::New(env, std::string(name) + " should hold integers from 0 to 31").ThrowAsJavaScriptException();
+      return 0;
+    }
+    mask |= 1U << static_cast<int>(value);
+  }
+  if (mask == 0) {
+    Napi::RangeError::New(env, std::string(name) + " should not be empty").ThrowAsJavaScriptException();
+  }
+  return mask;
+}
+
+/* decode-related render options, leaves a pending JS exception when one is invalid */
+auto obtain_render_options(const Napi::Object &options) -> RenderOptions {
+  RenderOptions render_options;
+  auto env = options.Env();
+
+  if (auto start = obtain_option<Napi::Number>(options, "start")) {
+    render_options.start_sample = start->Int32Value();
+  }
+  if (auto end = obtain_option<Napi::Number>(options, "end")) {
+    render_options.end_sample = end->Int32Value();
+  }
+  if (auto start_time = obtain_option<Napi::Number>(options, "startTime")) {
+    render_options.start_time = start_time->DoubleValue();
+  }
+  if (auto end_time = obtain_option<Napi::Number>(options, "endTime")) {
+    render_options.end_time = end_time->DoubleValue();
+  }
+  if (auto loop_count = obtain_option<Napi::Number>(options, "loopCount")) {
+    render_options.loop_count = loop_count->DoubleValue();
+  }
+  if (auto fade_time = obtain_option<Napi::Number>(options, "fadeTime")) {
+    render_options.fade_time = fade_time->DoubleValue();
+  }
+  if (auto fade_delay = obtain_option<Napi::Number>(options, "fadeDelay")) {
+    render_options.fade_delay = fade_delay->DoubleValue();
+  }
+  render_options.ignore_loop = obtain_option(options, "ignoreLoop", Napi::Boolean::New(env, false));
+  render_options.force_loop = obtain_option(options, "forceLoop", Napi::Boolean::New(env, false));
+  render_options.ignore_fade = obtain_option(options, "ignoreFade", Napi::Boolean::New(env, false));
+  render_options.play_forever = obtain_option(options, "playForever", Napi::Boolean::New(env, false));
+  render_options.smpl_chunk = obtain_option(options, "smplChunk", Napi::Boolean::New(env, false));
+  render_options.collect_stats = obtain_option(options, "stats", Napi::Boolean::New(env, false));
+  auto bad_loop = render_options.loop_count.value_or(1) <= 0 || render_options.fade_time.value_or(0) < 0 ||
+                  render_options.fade_delay.value_or(0) < 0;
+  if (bad_loop && !env.IsExceptionPending()) {
+    Napi::RangeError::New(env, "loopCount should be positive and fades should not be negative")
+        .ThrowAsJavaScriptException();
+  }
+
+  render_options.channel_mask = obtain_index_mask(options, "channels");
+  render_options.layer_mask = obtain_index_mask(options, "layers");
+  if (auto layer_channels = obtain_option<Napi::Number>(options, "layerChannels")) {
+    render_options.layer_channels = layer_channels->Int32Value();
+    if (render_options.layer_channels <= 0 && !env.IsExceptionPending()) {
+      Napi::RangeError::New(env, "layerChannels should be a positive number").ThrowAsJavaScriptException();
+    }
+  } else if (render_options.layer_mask != 0 && !env.IsExceptionPending()) {
+    Napi::TypeError::New(env, "layers needs layerChannels").ThrowAsJavaScriptException();
+  }
+  if (auto downmix = obtain_option<Napi::String>(options, "downmix")) {
+    auto target = downmix->Utf8Value();
+    if (target == "mono") {
+      render_options.downmix = 1;
+    } else if (target == "stereo") {
+      render_options.downmix = 2;
+    } else if (!env.IsExceptionPending()) {
+      Napi::RangeError::New(env, "downmix should be one of mono or stereo").ThrowAsJavaScriptException();
+    }
+  }
+
+  if (auto sample_rate = obtain_option<Napi::Number>(options, "sampleRate")) {
+    render_options.sample_rate = sample_rate->Int32Value();
+    if ((render_options.sample_rate < 1000 || render_options.sample_rate > 768000) && !env.IsExceptionPending()) {
+      Napi::RangeError::New(env, "sampleRate should be from 1000 to 768000").ThrowAsJavaScriptException();
+    }
+  }
+  auto quality = obtain_option(options, "resampleQuality", Napi::String::New(env, "medium")).Utf8Value();
+  if (quality == "low") {
+    render_options.resample_quality = Resampler::Quality::Low;
+  } else if (quality == "high") {
+    render_options.resample_quality = Resampler::Quality::High;
+  } else if (quality != "medium" && !env.IsExceptionPending()) {
+    Napi::RangeError::New(env, "resampleQuality should be one of low, medium or high").ThrowAsJavaScriptException();
+  }
+
+  if (auto segments = obtain_option<Napi::Number>(options, "parallel")) {
+    render_options.segments = segments->Int32Value();
+    if ((render_options.segments < 0 || render_options.segments > 64) && !env.IsExceptionPending()) {
+      Napi::RangeError::New(env, "parallel should be from 0 to 64").ThrowAsJavaScriptException();
+    }
+  }
+
+  auto format = obtain_option(options, "format", Napi::String::New(env, "wav")).Utf8Value();
+  if (format == "wav") {
+    render_options.format = OutputFormat::Wav;
+  } else if (format == "s16le") {
+    render_options.format = OutputFormat::S16;
+  } else if (format == "f32le") {
+    render_options.format = OutputFormat::F32;
+  } else if (format == "planar") {
+    render_options.format = OutputFormat::Planar;
+  } else if (format == "flac") {
+    render_options.format = OutputFormat::Flac;
+  } else {
+    Napi::RangeError::New(env, "format should be one of wav, s16le, f32le, planar or flac")
+        .ThrowAsJavaScriptException();
+  }
+
+  if (auto analyze = obtain_option<Napi::Object>(options, "analyze")) {
+    AnalysisOptions analysis;
+    analysis.peak_buckets = obtain_option(*analyze, "peaks", Napi::Number::New(env, 0)).Int32Value();
+    analysis.loudness = obtain_option(*analyze, "loudness", Napi::Boolean::New(env, false));
+    analysis.silence_threshold_db =
+        obtain_option(*analyze, "silenceThreshold", Napi::Number::New(env, analysis.silence_threshold_db));
+    if ((analysis.peak_buckets < 0 || analysis.peak_buckets > MaxPeakBuckets) && !env.IsExceptionPending()) {
+      Napi::RangeError::New(env, "analyze.peaks should be from 0 to " + std::to_string(MaxPeakBuckets))
+          .ThrowAsJavaScriptException();
+    }
+    if (analysis.silence_threshold_db > 0 && !env.IsExceptionPending()) {
+      Napi::RangeError::New(env, "analyze.silenceThreshold should be in dBFS, at most 0").ThrowAsJavaScriptException();
+    }
+    render_options.analysis = analysis;
+  }
+  /* the figures are the same for every format, int16 skips all conversion */
+  render_options.analysis_only = obtain_option(options, "analysisOnly", Napi::Boolean::New(env, false));
+  if (render_options.analysis_only) {
+    render_options.format = OutputFormat::S16;
+    if (!render_options.analysis) {
+      render_options.analysis = AnalysisOptions{};
+    }
+  }
+
+  if (render_options.start_sample.value_or(0) < 0 || render_options.end_sample.value_or(0) < 0 ||
+      render_options.start_time.value_or(0) < 0 || render_options.end_time.value_or(0) < 0) {
+    Napi::RangeError::New(env, "render bounds should not be negative").ThrowAsJavaScriptException();
+  }
+
+  return render_options;
+}
+
+/* companion files from the `files` map and `directory` options, nullptr when there are none; the buffers
+ * are appended to `buffers` so the caller can pin them */
+auto obtain_companions(const Napi::Object &options, Napi::Array &buffers, const std::string &default_directory)
+    -> std::shared_ptr<Companions> {
+  auto env = options.Env();
+  auto directory = obtain_option(options, "directory", Napi::String::New(env, default_directory)).Utf8Value();
+
+  std::unordered_map<std::string, MemoryView> files;
+  if (auto map = obtain_option<Napi::Object>(options, "files")) {
+    auto names = map->GetPropertyNames();
+    for (uint32_t i = 0; i < names.Length(); ++i) {
+      auto name = names.Get(i).ToString().Utf8Value();
+      Napi::Value file = map->Get(name);
+      if (!file.IsBuffer()) {
+        Napi::TypeError::New(env, "expect files[\"" + name + "\"] to be a buffer but not").ThrowAsJavaScriptException();
+        return nullptr;
+      }
+      auto buffer = file.As<NapiBuffer>();
+      files[name] = MemoryView{buffer.Data(), buffer.Length()};
+      buffers.Set(buffers.Length(), buffer);
+    }
+  }
+
+  if (files.empty() && directory.empty()) {
+    return nullptr;
+  }
+  return std::make_shared<Companions>(std::move(files), directory);
+}
+
+/* same as obtain_render_options, for renders that have to end */
+auto obtain_bounded_render_options(const Napi::Object &options) -> RenderOptions {
+  auto render_options = obtain_render_options(options);
+  if (render_options.unbounded() && !options.Env().IsExceptionPending()) {
+    Napi::RangeError::New(options.Env(), "playForever without an end is only available when streaming")
+        .ThrowAsJavaScriptException();
+  }
+  return render_options;
+}
+
+/* a finished render on its way to JS */
+struct RenderResult {
+  std::unique_ptr<ExtendableBuffer> buffer;
+  OutputFormat format = OutputFormat::Wav;
+  int channels = 0;
+  int32_t samples = 0;
+  std::optional<RenderStats> stats = std::nullopt;
+  std::optional<Analysis> analysis = std::nullopt;
+  /* the memory budget this render was admitted under, given back once the result is delivered */
+  MemoryBudget::Reservation reservation;
+
+  /* the data, or {data, stats, analysis} with whichever of the last two were asked for; no data for an
+   * analysis-only render */
+  auto to_value(Napi::Env env) -> Napi::Value {
+    if (!stats && !analysis) {
+      return data_value(env);
+    }
+    auto deliver_ms = stats ? RenderStats::elapsed_ms(stats->finished) : 0.0;
+    auto $ = Helper(env);
+
+    return $.object([&](auto result) {
+      if (buffer) {
+        result["data"] = data_value(env);
+      }
+      if (analysis) {
+        result["analysis"] = analysis_value(env);
+      }
+      if (!stats) {
+        return;
+      }
+      result["stats"] = $.object([&](auto stats_object) {
+        stats_object["queueMs"] = stats->queue_ms;
+        stats_object["openMs"] = stats->open_ms;
+        stats_object["memoryWaitMs"] = stats->memory_wait_ms;
+        stats_object["decodeMs"] = stats->decode_ms;
+        stats_object["deliverMs"] = deliver_ms;
+        stats_object["samples"] = static_cast<double>(stats->samples);
+        stats_object["bytes"] = static_cast<double>(stats->bytes);
+        stats_object["allocatedBytes"] = static_cast<double>(stats->allocated);
+        stats_object["resizes"] = static_cast<double>(stats->resizes);
+        stats_object["cacheHit"] = stats->cache_hit;
+      });
+    });
+  }
+
+ private:
+  auto analysis_value(Napi::Env env) -> Napi::Value {
+    auto $ = Helper(env);
+    auto to_db = [](const double level) { return 20.0 * std::log10(level); };
+
+    return $.object([&](auto analysis_object) {
+      analysis_object["peak"] = analysis->peak;
+      analysis_object["peakDb"] = to_db(analysis->peak);
+      analysis_object["rms"] = analysis->rms;
+      analysis_object["rmsDb"] = to_db(analysis->rms);
+      if (analysis->loudness) {
+        analysis_object["loudness"] = *analysis->loudness;
+      }
+      analysis_object["leadingSilence"] = analysis->leading_silence;
+      analysis_object["trailingSilence"] = analysis->trailing_silence;
+      if (!analysis->peaks.empty()) {
+        auto peaks = Napi::Float32Array::New(env, analysis->peaks.size());
+        std::copy(analysis->peaks.begin(), analysis->peaks.end(), peaks.Data());
+        analysis_object["peaks"] = peaks;
+      }
+    });
+  }
+
+  /* a Buffer, or one Float32Array per channel sharing its memory for planar output */
+  auto data_value(Napi::Env env) -> Napi::Value {
+    auto data = buffer->move_to_node_buffer(env);
+    if (format != OutputFormat::Planar) {
+      return data;
+    }
+
+    auto plane_length = channels > 0 ? data.Length() / sizeof(float) / channels : 0;
+    auto planes = Napi::Array::New(env, channels);
+    for (int channel = 0; channel < channels; ++channel) {
+      planes[channel] = Napi::Float32Array::New(
+          env, plane_length, data.ArrayBuffer(), data.ByteOffset() + channel * plane_length * sizeof(float)
+      );
+    }
+    return planes;
+  }
+};
+
+/* the `timeout` (ms) and `signal` options, nullptr when there are neither; an already aborted signal trips
+ * the token straight away */
+auto obtain_cancel_token(const Napi::Object &options) -> std::shared_ptr<CancelToken> {
+  auto timeout = obtain_option<Napi::Number>(options, "timeout");
+  auto signal = obtain_option<Napi::Object>(options, "signal");
+  if (!timeout && !signal) {
+    return nullptr;
+  }
+
+  std::optional<CancelToken::Clock::time_point> deadline;
+  if (timeout) {
+    auto milliseconds = std::max(timeout->DoubleValue(), 0.0);
+    deadline = CancelToken::Clock::now() + std::chrono::duration_cast<CancelToken::Clock::duration>(
+                                               std::chrono::duration<double, std::milli>(milliseconds)
+                                           );
+  }
+  auto token = std::make_shared<CancelToken>(deadline);
+  if (signal && signal->Get("aborted").ToBoolean()) {
+    token->abort();
+  }
+  return token;
+}
+
+/* trips `token` when the `signal` option aborts, listening only until `promise` settles */
+void watch_abort_signal(
+    const Napi::Object &options, const std::shared_ptr<CancelToken> &token, const Napi::Promise &promise
+) {
+  auto env = options.Env();
+  if (!token || !options.Get("signal").IsObject()) {
+    return;
+  }
+  auto signal = options.Get("signal").As<Napi::Object>();
+  auto on_abort = Napi::Function::New(env, [token](const Napi::CallbackInfo &info) { token->abort(); });
+  signal.Get("addEventListener").As<Napi::Function>().Call(signal, {Napi::String::New(env, "abort"), on_abort});
+
+  auto listener = std::make_shared<Napi::FunctionReference>(Napi::Persistent(on_abort));
+  auto target = std::make_shared<Napi::ObjectReference>(Napi::Persistent(signal));
+  auto cleanup = Napi::Function::New(env, [listener, target](const Napi::CallbackInfo &info) {
+    auto signal = target->Value();
+    signal.Get("removeEventListener")
+        .As<Napi::Function>()
+        .Call(signal, {Napi::String::New(info.Env(), "abort"), listener->Value()});
+  });
+  // then() rather than finally() so the derived promise never rejects unhandled
+  promise.Get("then").As<Napi::Function>().Call(promise, {cleanup, cleanup});
+}
+
+/* adds a finished chunk to the module-wide counters */
+void count_chunk(const int32_t samples, const ExtendableBuffer &buf) {
+  auto &counters = RenderCounters::instance();
+  RenderCounters::add(counters.samples_decoded, samples);
+  RenderCounters::add(counters.bytes_allocated, buf.allocated());
+  RenderCounters::add(counters.resizes, buf.resize_count());
+}
+
+/* counts a finished chunk and wraps it up, with the analysis once the renderer has measured everything */
+auto finish_chunk(const Renderer &renderer, const int32_t length, std::unique_ptr<ExtendableBuffer> buf)
+    -> RenderResult * {
+  if (buf) {
+    count_chunk(length, *buf);
+  } else {
+    RenderCounters::add(RenderCounters::instance().samples_decoded, length);
+  }
+
+  auto *result = new RenderResult{std::move(buf), renderer.output_format(), renderer.output_channels(), length};
+  if (const auto *analyzer = renderer.analyzer(); analyzer != nullptr && renderer.finished()) {
+    result->analysis = analyzer->finish();
+  }
+  return result;
+}
+
+/* render_chunk for analysis-only renders: blocks are decoded into one scratch block, measured and dropped,
+ * so the result holds no data */
+auto analyze_chunk(Renderer &renderer, const int32_t length, const CancelToken *cancel) -> RenderResult * {
+  std::vector<uint8_t> block(renderer.scratch_size(Renderer::BlockSamples));
+  for (int32_t done = 0; done < length;) {
+    if (cancel != nullptr && cancel->tripped()) {
+      return nullptr;
+    }
+    done += renderer.render(block.data(), length - done);
+  }
+  return finish_chunk(renderer, length, nullptr);
+}
+
+/* render_chunk for Flac output, whose size is only known once encoded: blocks are decoded into a scratch
+ * block and the frames they complete are appended, the last frame once the renderer is finished */
+auto encode_chunk(Renderer &renderer, const int32_t length, const bool with_header, const CancelToken *cancel)
+    -> RenderResult * {
+  auto *encoder = renderer.encoder();
+  if (encoder == nullptr) {
+    return nullptr;
+  }
+
+  // game audio rarely packs below half of its PCM size, so this mostly grows once or not at all
+  auto buf = std::make_unique<ExtendableBuffer>(renderer.output_size(length) / 2 + Renderer::HeaderCapacity);
+  std::vector<sample_t> block(renderer.scratch_size(Renderer::BlockSamples) / sizeof(sample_t));
+  std::vector<uint8_t> encoded;
+  if (with_header) {
+    encoder->write_header(encoded);
+  }
+  for (int32_t done = 0; done < length;) {
+    if (cancel != nullptr && cancel->tripped()) {
+      return nullptr;
+    }
+    auto samples_done = renderer.render(reinterpret_cast<uint8_t *>(block.data()), length - done);
+    encoder->push(block.data(), samples_done, encoded);
+    done += samples_done;
+    buf->push(encoded.data(), encoded.size());
+    encoded.clear();
+  }
+  if (renderer.finished()) {
+    encoder->finish(encoded);
+    buf->push(encoded.data(), encoded.size());
+  }
+
+  return finish_chunk(renderer, length, std::move(buf));
+}
+
+/* renders the next `samples` samples per channel straight into an exactly sized buffer,
+ * with the .wav header in front when asked; nullptr once `cancel` trips, checked between blocks */
+auto render_chunk(
+    Renderer &renderer, const int32_t samples, const bool with_header, const CancelToken *cancel = nullptr
+) -> RenderResult * {
+  auto length = std::min(samples, renderer.remaining());
+  if (renderer.output_format() == OutputFormat::Flac) {
+    return encode_chunk(renderer, length, with_header, cancel);
+  }
+  auto buf = std::make_unique<ExtendableBuffer>(renderer.chunk_size(length, with_header));
+
+  if (with_header) {
+    auto header_size = renderer.header_size();
+    buf->ensure<uint8_t>(header_size);
+    buf->expose<uint8_t>([&](auto *wav_buf) { return renderer.write_header(wav_buf, header_size); });
+  }
+
+  auto cancelled = [&] { return cancel != nullptr && cancel->tripped(); };
+
+  if (renderer.output_format() == OutputFormat::Planar) {
+    auto complete = true;
+    buf->expose<uint8_t>([&](auto *planes) {
+      for (int32_t done = 0; done < length;) {
+        if (cancelled()) {
+          complete = false;
+          return static_cast<size_t>(0);
+        }
+        done += renderer.render(planes + done * sizeof(float), length - done, length * sizeof(float));
+      }
+      return renderer.output_size(length);
+    });
+    if (!complete) {
+      return nullptr;
+    }
+  } else {
+    for (int32_t done = 0; done < length;) {
+      if (cancelled()) {
+        return nullptr;
+      }
+      buf->ensure<uint8_t>(renderer.scratch_size(std::min(length - done, Renderer::BlockSamples)));
+      buf->expose<uint8_t>([&](auto *buffer) {
+        auto samples_done = renderer.render(buffer, length - done);
+        done += samples_done;
+        return renderer.output_size(samples_done);
+      });
+    }
+  }
+
+  return finish_chunk(renderer, length, std::move(buf));
+}
+
+class VGMStreamReader : public Napi::ObjectWrap<VGMStreamReader> {
+ private:
+  Helper $;
+
+  BankHandle handle;
+  std::shared_ptr<Renderer> renderer;
+  int32_t chunk_samples = Renderer::BlockSamples;
+  bool header_pending = true;
+  bool reading = false;
+
+ public:
+  explicit VGMStreamReader(const Napi::CallbackInfo &info) : Napi::ObjectWrap<VGMStreamReader>(info), $(info.Env()) {
+    auto handle = BankHandle::from_arg(info[0]);
+    auto stream_index = obtain_arg<Napi::Number>(info, 1).Int32Value();
+    auto options = obtain_arg<Napi::Object>(info, 2, Napi::Object::New(info.Env()));
+    auto render_options = obtain_render_options(options);
+    if ($.env.IsExceptionPending()) {
+      return;
+    }
+    // analysis covers whole renders only
+    render_options.analysis.reset();
+    render_options.analysis_only = false;
+
+    this->chunk_samples = obtain_option(options, "chunkSize", Napi::Number::New($.env, Renderer::BlockSamples));
+    if (this->chunk_samples <= 0) {
+      $.throws("chunkSize should be a positive number of samples");
+      return;
+    }
+
+    auto prepared = false;
+    auto vgmstream = handle.bank->open(stream_index, render_options.setup_key(), &prepared);
+    if (!vgmstream) {
+      $.throws(OpenFailure);
+      return;
+    }
+    this->handle = handle;
+    this->renderer = std::make_shared<Renderer>(vgmstream, render_options, prepared);
+    if (render_options.format == OutputFormat::Flac && renderer->encoder() == nullptr) {
+      renderer.reset();
+      $.throws(FlacChannelFailure);
+    }
+  }
+
+  [[nodiscard]]
+  auto exhausted() const -> bool {
+    return !renderer || (!header_pending && renderer->finished());
+  }
+
+  auto read_sync(const Napi::CallbackInfo &info) -> Napi::Value {
+    if (reading) {
+      return $.throws("another read is still in progress");
+    }
+    if (exhausted()) {
+      return $.null();
+    }
+    auto with_header = std::exchange(header_pending, false);
+    auto result = std::unique_ptr<RenderResult>(render_chunk(*renderer, chunk_samples, with_header));
+    return result->to_value($.env);
+  }
+
+  auto read_async(const Napi::CallbackInfo &info) -> Napi::Value {
+    if (reading) {
+      return $.throws("another read is still in progress");
+    }
+    if (exhausted()) {
+      return $.resolved($.null());
+    }
+
+    reading = true;
+    this->Ref();
+    /* close() may drop the handle mid-read: the transform keeps the bank until after the job (and its
+     * renderer) is gone, the promise keeps the input buffer */
+    auto promise = $.async<RenderResult>(
+        [renderer = renderer, chunk_samples = chunk_samples, with_header = std::exchange(header_pending, false)](
+            auto resolve, auto reject
+        ) { resolve(render_chunk(*renderer, chunk_samples, with_header)); },
+        [this, bank = handle.bank](auto env, auto value) {
+          reading = false;
+          this->Unref();
+          return value->to_value(env);
+        }
+    );
+    handle.retain(promise);
+    return promise;
+  }
+
+  auto close(const Napi::CallbackInfo &info) -> Napi::Value {
+    renderer.reset();
+    handle = BankHandle{};
+    return $.undefined();
+  }
+
+  static auto init(Napi::Env env, Napi::Object exports) {
+    auto reader_class = DefineClass(
+        env,
+        "VGMStreamReader",
+        {
+            InstanceMethod<&VGMStreamReader::read_sync>("readSync"),
+            InstanceMethod<&VGMStreamReader::read_async>("read"),
+            InstanceMethod<&VGMStreamReader::close>("close"),
+        }
+    );
+    AddonData::of(env).reader = Napi::Persistent(reader_class);
+    exports["VGMStreamReader"] = reader_class;
+  }
+};
+
 class VGMStreamSubSong : public Napi::ObjectWrap<VGMStreamSubSong> {
  private:
   const Napi::CallbackInfo *info = nullptr;
   Helper $;
 
-  using BufferRef = Napi::Reference<NapiBuffer>;
-
   int stream_index;
-  std::shared_ptr<BufferRef> buffer_ref;
-  std::string filename;
-  std::shared_ptr<VGMSTREAM> vgmstream_ptr;
-  vgmstream_info bank_info;
+  BankHandle handle;
 
  public:
   explicit VGMStreamSubSong(const Napi::CallbackInfo &info)
       : Napi::ObjectWrap<VGMStreamSubSong>(info), info(&info), $(info.Env()) {
-    auto buffer = obtain_arg<NapiBuffer>(info, 0);
-    auto stream_index = obtain_arg<Napi::Number>(info, 1).Int32Value();
-    auto filename = obtain_arg<Napi::String>(info, 2).Utf8Value();
-
-    this->buffer_ref = std::make_shared<BufferRef>(std::move(BufferRef::New(buffer, 1)));
-    this->vgmstream_ptr = vgmstream_from_buffer(buffer, stream_index, filename);
-    describe_vgmstream_info(vgmstream_ptr.get(), &bank_info);
+    this->stream_index = obtain_arg<Napi::Number>(info, 1).Int32Value();
+    if (info[0].IsExternal()) {
+      this->handle = BankHandle::from_arg(info[0]);
+    } else {
+      auto buffer = obtain_arg<NapiBuffer>(info, 0);
+      auto filename = obtain_arg<Napi::String>(info, 2).Utf8Value();
+      this->handle = BankHandle::from_buffer(buffer, filename);
+    }
   }
 
   auto get_info(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto descriptor = handle.bank->describe(stream_index);
+    if (!descriptor) {
+      return $.throws(OpenFailure);
+    }
+    const auto &bank_info = *descriptor;
+
     return $.object([&](auto meta) {
       meta["version"] = VGMSTREAM_VERSION;
       meta["sampleRate"] = bank_info.sample_rate;
@@ -85,111 +716,399 @@ class VGMStreamSubSong : public Napi::ObjectWrap<VGMStreamSubSong> {
     });
   }
 
-  static auto render_to_wave(const std::shared_ptr<VGMSTREAM> &vgmstream_ptr) {
-    // fake configs
-    const size_t sample_buffer_size = 8192;
-    const int32_t seek_samples2 = -1;
-    const int32_t seek_samples1 = -1;
+  /* below this many samples per piece, a split render costs more in decoders than it saves */
+  static constexpr int32_t MinSegmentSamples = 4 * Renderer::BlockSamples;
+
+  /* how render_split() cuts the window of `first`: the number of pieces (1 when it renders serially) and the
+   * samples in each but the last; no more pieces than the pool or the machine has threads to run them */
+  static auto plan_segments(const Renderer &first, const RenderOptions &options) -> std::pair<int32_t, int32_t> {
+    auto length = first.remaining();
+    auto threads = static_cast<int32_t>(std::min(WorkerPool::instance()->size(), WorkerPool::default_threads()));
+    auto segments = std::min({options.segments, length / MinSegmentSamples, threads});
+    if (segments < 2 || !first.splittable()) {
+      return {1, length};
+    }
 
-    const bool decode_only = false;
+    // whole blocks per piece, the last one takes what is left
+    auto blocks = (length / segments + Renderer::BlockSamples - 1) / Renderer::BlockSamples;
+    auto segment_length = blocks * Renderer::BlockSamples;
+    return {(length + segment_length - 1) / segment_length, segment_length};
+  }
 
-    const bool write_lwav = false;
-    const int lwav_loop_start = 0;
-    const int lwav_loop_end = 0;
-    // end of fake configs
+  /* what is left of the renderer's window as one result, measured and dropped when only analysis was asked */
+  static auto render_whole(Renderer &renderer, const RenderOptions &options, const CancelToken *cancel)
+      -> RenderResult * {
+    if (options.analysis_only) {
+      return analyze_chunk(renderer, renderer.remaining(), cancel);
+    }
+    return render_chunk(renderer, renderer.remaining(), true, cancel);
+  }
 
-    auto *vgmstream = vgmstream_ptr.get();
+  /* renders the window of `first` in up to `options.segments` pieces at once, each over its own decoder of the
+   * sub-song and straight into its part of the output; the pieces go to idle pool threads, and the calling
+   * thread renders those none took. Serial when splittable() rules it out */
+  static auto render_split(
+      const std::shared_ptr<Bank> &bank,
+      const int stream_index,
+      const RenderOptions &options,
+      Renderer &first,
+      const CancelToken *cancel
+  ) -> RenderResult * {
+    auto length = first.remaining();
+    // no structured binding, the pieces below capture these
+    auto plan = plan_segments(first, options);
+    auto segments = plan.first;
+    auto segment_length = plan.second;
+    if (segments < 2) {
+      return render_whole(first, options, cancel);
+    }
 
-    auto channels = vgmstream->channels;
-    auto input_channels = vgmstream->channels;
-    vgmstream_mixing_enable(vgmstream, 0, &input_channels, &channels);
+    auto [window_start, window_end] = first.window();
+    std::vector<std::unique_ptr<Renderer>> renderers;
+    for (int32_t segment = 1; segment < segments; ++segment) {
+      auto segment_prepared = false;
+      auto decoder = bank->open(stream_index, options.setup_key(), &segment_prepared);
+      if (!decoder) {
+        return render_whole(first, options, cancel);
+      }
+      auto segment_options = options;
+      segment_options.start_sample = window_start + segment * segment_length;
+      segment_options.end_sample = std::min(window_end, window_start + (segment + 1) * segment_length);
+      renderers.push_back(std::make_unique<Renderer>(decoder, segment_options, segment_prepared));
+    }
 
-    auto *buf = new ExtendableBuffer(sample_buffer_size * sizeof(sample_t) * input_channels);
+    auto buf = std::make_unique<ExtendableBuffer>(first.chunk_size(length, true));
+    auto header_size = first.header_size();
+    buf->ensure<uint8_t>(header_size);
+    buf->expose<uint8_t>([&](auto *wav_buf) { return first.write_header(wav_buf, header_size); });
 
-    /* simulate seek */
-    auto len_samples = vgmstream_get_samples(vgmstream);
-    if (seek_samples2 >= 0) {
-      len_samples -= seek_samples2;
-    } else if (seek_samples1 >= 0) {
-      len_samples -= seek_samples1;
+    std::atomic<bool> failed{false};
+    auto planar = first.output_format() == OutputFormat::Planar;
+    buf->ensure<uint8_t>(first.output_size(length));
+    buf->expose<uint8_t>([&](auto *data) {
+      auto render_segment = [&](Renderer &renderer, const int32_t offset, const int32_t samples) {
+        for (int32_t done = 0; done < samples;) {
+          if (failed || (cancel != nullptr && cancel->tripped())) {
+            failed = true;
+            return;
+          }
+          auto position = offset + done;
+          auto *dst = planar ? data + position * sizeof(float) : data + renderer.output_size(position);
+          done += renderer.render(dst, samples - done, planar ? length * sizeof(float) : 0);
+        }
+      };
+
+      WorkerPool::instance()->run_all(segments, [&](const size_t segment) {
+        if (segment == 0) {
+          render_segment(first, 0, segment_length);
+          return;
+        }
+        auto &renderer = *renderers[segment - 1];
+        render_segment(renderer, static_cast<int32_t>(segment) * segment_length, renderer.remaining());
+      });
+      return failed ? static_cast<size_t>(0) : first.output_size(length);
+    });
+    if (failed) {
+      return nullptr;
     }
 
-    if (seek_samples1 >= 0) {
-      seek_vgmstream(vgmstream, seek_samples1);
+    count_chunk(length, *buf);
+    return new RenderResult{std::move(buf), first.output_format(), first.output_channels(), length};
+  }
+
+  /* what a render holds until its result reaches JS: the output, the copy handed to the render cache, and
+   * the decoder and scratch block of each extra piece of a split render; the scratch block alone for
+   * analysis-only renders */
+  static auto footprint(const Renderer &renderer, const RenderOptions &options, const bool cached) -> size_t {
+    if (options.analysis_only) {
+      return renderer.scratch_size(Renderer::BlockSamples);
     }
-    if (seek_samples2 >= 0) {
-      seek_vgmstream(vgmstream, seek_samples2);
+    auto output = renderer.chunk_size(renderer.remaining(), true);
+    auto total = cached ? output * 2 : output;
+    if (options.segments > 1) {
+      auto extra_segments = static_cast<size_t>(plan_segments(renderer, options).first - 1);
+      // ch, start_ch and loop_ch hold a channel state each
+      auto decoder = sizeof(VGMSTREAM) + 3 * sizeof(VGMSTREAMCHANNEL) * renderer.output_channels();
+      total += extra_segments * (decoder + renderer.scratch_size(Renderer::BlockSamples));
     }
+    return total;
+  }
 
-    const size_t buffer_size = 1024;
+  /* a render from finding what it needs to being admitted by the memory budget: the cache entry to copy, or
+   * the decoder to render from */
+  struct PendingRender {
+    std::shared_ptr<Bank> bank;
+    int stream_index = 0;
+    RenderOptions options;
+    std::shared_ptr<CancelToken> cancel;
+    RenderStats::Clock::time_point begin;
+    RenderStats::Clock::time_point opened;
+    std::string key;
+    std::optional<RenderCache::Entry> hit;
+    std::unique_ptr<Renderer> renderer;
+    size_t bytes = 0;
+  };
 
-    /* slap on a .wav header */
-    if (!decode_only) {
-      buf->ensure<uint8_t>(buffer_size);
-      buf->expose<uint8_t>([&](auto *wav_buf) {
-        wav_header_t wav = {
-            .sample_count = len_samples,
-            .sample_rate = vgmstream->sample_rate,
-            .channels = channels,
-            .write_smpl_chunk = write_lwav,
-            .loop_start = lwav_loop_start,
-            .loop_end = lwav_loop_end
-        };
+  /* hands a render over: the result, or nullptr with the reason, which is only good for the call */
+  using Rendered = std::function<void(RenderResult *result, const char *failure)>;
 
-        size_t bytes_done = wav_make_header(wav_buf, buffer_size, &wav);
+  /* looks the render up in the render cache, or opens its decoder; nullptr with the reason in `failure` when
+   * it cannot be opened or `cancel` tripped while it was queued */
+  static auto prepare_render(
+      const std::shared_ptr<Bank> &bank,
+      const int stream_index,
+      const RenderOptions &options,
+      const std::shared_ptr<CancelToken> &cancel,
+      const char **failure
+  ) -> std::shared_ptr<PendingRender> {
+    auto pending = std::make_shared<PendingRender>();
+    pending->bank = bank;
+    pending->stream_index = stream_index;
+    pending->options = options;
+    pending->cancel = cancel;
+    pending->begin = RenderStats::Clock::now();
 
-        return bytes_done;
-      });
+    auto cache = RenderCache::instance();
+    // the cache keeps data only, analysis needs the decode
+    if (cache->enabled() && !options.analysis && bank->cacheable()) {
+      pending->key = bank->content_key(stream_index) + "/" + options.cache_key();
+      pending->hit = cache->find(pending->key);
+      if (pending->hit) {
+        pending->bytes = pending->hit->data->size();
+        return pending;
+      }
     }
 
-    /* decode */
+    // it may have waited in the queue past its deadline
+    if (cancel && cancel->tripped()) {
+      *failure = cancel->reason();
+      return nullptr;
+    }
+    auto prepared = false;
+    auto vgmstream = bank->open(stream_index, options.setup_key(), &prepared);
+    if (!vgmstream) {
+      *failure = OpenFailure;
+      return nullptr;
+    }
+    pending->renderer = std::make_unique<Renderer>(vgmstream, options, prepared);
+    pending->opened = RenderStats::Clock::now();
+    pending->bytes = footprint(*pending->renderer, options, !pending->key.empty());
+    return pending;
+  }
 
-    for (auto i = 0; i < len_samples; i += sample_buffer_size) {
-      int to_get = sample_buffer_size;
-      if (i + sample_buffer_size > len_samples) {
-        to_get = len_samples - i;
+  /* the admitted half of a render; nullptr with the reason in `failure` when cancelled or the encoder turns it
+   * down */
+  static auto finish_render(
+      PendingRender &pending, MemoryBudget::Reservation reservation, const double memory_wait_ms, const char **failure
+  ) -> RenderResult * {
+    const auto &options = pending.options;
+    if (pending.hit) {
+      const auto &hit = *pending.hit;
+      auto buf = std::make_unique<ExtendableBuffer>(hit.data->size());
+      buf->push(hit.data->data(), hit.data->size());
+      auto *result = new RenderResult{std::move(buf), options.format, hit.channels, hit.samples};
+      result->reservation = std::move(reservation);
+      if (options.collect_stats) {
+        result->stats = RenderStats{};
+        result->stats->memory_wait_ms = memory_wait_ms;
+        result->stats->decode_ms = RenderStats::elapsed_ms(pending.begin) - memory_wait_ms;
+        result->stats->cache_hit = true;
+        fill_stats(*result);
       }
+      return result;
+    }
+
+    auto *cancel = pending.cancel.get();
+    auto &renderer = *pending.renderer;
+    auto decoding = RenderStats::Clock::now();
+    auto *result = options.segments > 1
+                     ? render_split(pending.bank, pending.stream_index, options, renderer, cancel)
+                     : render_whole(renderer, options, cancel);
+    if (result == nullptr) {
+      // either cancelled between blocks or more channels than the encoder takes
+      *failure = cancel != nullptr && cancel->tripped() ? cancel->reason() : FlacChannelFailure;
+      return nullptr;
+    }
+    result->reservation = std::move(reservation);
+    RenderCounters::add(RenderCounters::instance().renders, 1);
 
-      const auto length = channels * to_get;
-      buf->ensure<uint16_t>(length);
-      buf->expose<uint16_t>([&](auto *buffer) {
-        auto samples_done = render_vgmstream(reinterpret_cast<sample_t *>(buffer), to_get, vgmstream);
+    if (options.collect_stats) {
+      result->stats = RenderStats{};
+      result->stats->open_ms = std::chrono::duration<double, std::milli>(pending.opened - pending.begin).count();
+      result->stats->memory_wait_ms = memory_wait_ms;
+      result->stats->decode_ms = RenderStats::elapsed_ms(decoding);
+      fill_stats(*result);
+    }
+    // opening the sub-song may have asked for companion files parsing the bank did not
+    if (!pending.key.empty() && pending.bank->cacheable()) {
+      const auto *data = result->buffer->data();
+      auto copy = std::make_shared<const std::vector<uint8_t>>(data, data + result->buffer->size());
+      RenderCache::instance()->insert(pending.key, {std::move(copy), result->channels, result->samples});
+    }
+    return result;
+  }
 
-        if (!decode_only) {
-          wav_swap_samples_le(buffer, length, 0);
-          return length;
+  /* finishes an admitted render and hands it over, what it throws included; the decoder is given back first */
+  static void run_render(
+      std::shared_ptr<PendingRender> pending,
+      MemoryBudget::Reservation reservation,
+      const double memory_wait_ms,
+      const Rendered &rendered
+  ) {
+    const char *failure = nullptr;
+    RenderResult *result = nullptr;
+    try {
+      result = finish_render(*pending, std::move(reservation), memory_wait_ms, &failure);
+    } catch (const std::exception &error) {
+      pending.reset();
+      rendered(nullptr, error.what());
+      return;
+    }
+    pending.reset();
+    rendered(result, failure);
+  }
+
+  /* the whole sub-song, served from the render cache when it is enabled, and handed to `rendered` on this
+   * thread, unless it has to wait for the memory budget: then it gives the thread back, waits in the budget's
+   * queue, and goes back on the pool at `priority` once admitted. Without `wait` it is turned down instead */
+  static void render_cached(
+      const std::shared_ptr<Bank> &bank,
+      const int stream_index,
+      const RenderOptions &options,
+      const std::shared_ptr<CancelToken> &cancel,
+      const bool wait,
+      const int priority,
+      const Rendered &rendered
+  ) {
+    const char *failure = nullptr;
+    std::shared_ptr<PendingRender> pending;
+    std::optional<MemoryBudget::Reservation> reservation;
+    try {
+      pending = prepare_render(bank, stream_index, options, cancel, &failure);
+      if (pending) {
+        std::function<bool()> cancelled;
+        if (cancel) {
+          cancelled = [cancel] { return cancel->tripped(); };
         }
+        auto reserving = RenderStats::Clock::now();
+        auto admitted = [pending, rendered, priority, reserving](auto reservation) mutable {
+          if (!reservation) {
+            const auto *reason = pending->cancel->reason();
+            pending.reset();
+            rendered(nullptr, reason);
+            return;
+          }
+          std::string error_message = "render queue is full";
+          try {
+            auto held = std::make_shared<MemoryBudget::Reservation>(std::move(*reservation));
+            auto job = [pending, rendered, held, reserving]() mutable {
+              run_render(std::move(pending), std::move(*held), RenderStats::elapsed_ms(reserving), rendered);
+            };
+            pending.reset();
+            if (WorkerPool::instance()->submit(std::move(job), priority)) {
+              return;
+            }
+          } catch (const std::exception &error) {
+            error_message = error.what();
+          }
+          pending.reset();
+          rendered(nullptr, error_message.c_str());
+        };
+        reservation = MemoryBudget::instance()->reserve(pending->bytes, wait, cancelled, admitted, &failure);
+      }
+    } catch (const std::exception &error) {
+      rendered(nullptr, error.what());
+      return;
+    }
 
-        return 0;
-      });
+    if (reservation) {
+      run_render(std::move(pending), std::move(*reservation), 0, rendered);
+    } else if (!pending || failure != nullptr) {
+      rendered(nullptr, failure);
     }
+    // otherwise queued for memory, the budget's thread carries on
+  }
 
-    return buf;
+  /* the figures read off the output buffer, and the moment it is handed over */
+  static void fill_stats(RenderResult &result) {
+    result.stats->samples = result.samples;
+    result.stats->bytes = result.buffer ? result.buffer->size() : 0;
+    result.stats->allocated = result.buffer ? result.buffer->allocated() : 0;
+    result.stats->resizes = result.buffer ? result.buffer->resize_count() : 0;
+    result.stats->finished = RenderStats::Clock::now();
   }
 
   auto render_sync(const Napi::CallbackInfo &info) -> Napi::Value {
-    auto *buf = VGMStreamSubSong::render_to_wave(this->vgmstream_ptr);
-    auto result = buf->move_to_node_buffer($.env);
-    delete buf;
-    return result;
+    auto options = obtain_arg<Napi::Object>(info, 0, Napi::Object::New(info.Env()));
+    auto render_options = obtain_bounded_render_options(options);
+    auto cancel = obtain_cancel_token(options);
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+
+    // without waiting for memory, it is handed over before render_cached() returns
+    std::unique_ptr<RenderResult> result;
+    std::string failure;
+    render_cached(handle.bank, stream_index, render_options, cancel, false, 0, [&](auto *rendered, auto *reason) {
+      result.reset(rendered);
+      failure = reason != nullptr ? reason : "";
+    });
+    if (!result) {
+      return $.throws(failure.c_str());
+    }
+    return result->to_value($.env);
   }
 
   auto render_async(const Napi::CallbackInfo &info) -> Napi::Value {
-    auto promise = $.async<ExtendableBuffer>(
-        [vgmstream_ptr = vgmstream_ptr](auto resolve, auto reject) {
-          resolve(VGMStreamSubSong::render_to_wave(vgmstream_ptr));
+    auto options = obtain_arg<Napi::Object>(info, 0, Napi::Object::New(info.Env()));
+    auto priority = obtain_option(options, "priority", Napi::Number::New($.env, 0)).Int32Value();
+    auto render_options = obtain_bounded_render_options(options);
+    auto cancel = obtain_cancel_token(options);
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+
+    auto promise = $.async<RenderResult>(
+        [bank = handle.bank, stream_index = stream_index, render_options, cancel, priority,
+         submitted = RenderStats::Clock::now()](auto resolve, auto reject) {
+          auto queue_ms = RenderStats::elapsed_ms(submitted);
+          VGMStreamSubSong::render_cached(
+              bank,
+              stream_index,
+              render_options,
+              cancel,
+              true,
+              priority,
+              [resolve, reject, queue_ms](auto *result, auto *failure) {
+                if (result == nullptr) {
+                  reject(failure);
+                  return;
+                }
+                if (result->stats) {
+                  result->stats->queue_ms = queue_ms;
+                }
+                resolve(result);
+              }
+          );
         },
-        [](auto env, auto value) { return value->move_to_node_buffer(env); }
+        [](auto env, auto value) { return value->to_value(env); },
+        priority
     );
-    this->buffer_ref->Ref();
-
-    auto finalizer = [buffer_ref = buffer_ref](Napi::Env env, void *data) { buffer_ref->Unref(); };
-    promise.AddFinalizer<decltype(finalizer), void>(finalizer, nullptr);
+    handle.retain(promise);
+    watch_abort_signal(options, cancel, promise);
 
     return promise;
   }
 
-  static auto init(Napi::Env env) {
+  auto open_reader(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto options = obtain_arg<Napi::Object>(info, 0, Napi::Object::New(info.Env()));
+
+    return AddonData::of($.env).reader.New(
+        {Napi::External<BankHandle>::New($.env, &handle), $.number(this->stream_index), options}
+    );
+  }
+
+  static auto init(Napi::Env env, Napi::Object exports) {
     auto sub_song_class = DefineClass(
         env,
         "VGMStreamSubSong",
@@ -197,32 +1116,220 @@ class VGMStreamSubSong : public Napi::ObjectWrap<VGMStreamSubSong> {
             InstanceAccessor<&VGMStreamSubSong::get_info>("info"),
             InstanceMethod<&VGMStreamSubSong::render_sync>("renderSync"),
             InstanceMethod<&VGMStreamSubSong::render_async>("render"),
+            InstanceMethod<&VGMStreamSubSong::open_reader>("openReader"),
         }
     );
-    auto *constructor = new Napi::FunctionReference();
-    VGMStreamSubSong::constructor = new Napi::FunctionReference();
-    *VGMStreamSubSong::constructor = Napi::Persistent(sub_song_class);
+    AddonData::of(env).sub_song = Napi::Persistent(sub_song_class);
+    exports["VGMStreamSubSong"] = sub_song_class;
+  }
+};
+
+/* renders several sub-songs of one bank, keeping at most `concurrency` of them on the pool at once */
+class Batch {
+ public:
+  explicit Batch(
+      Napi::Env env,
+      BankHandle handle,
+      std::vector<int> indices,
+      const RenderOptions &options,
+      const size_t concurrency,
+      const int priority,
+      const Napi::Function &callback,
+      std::shared_ptr<CancelToken> cancel
+  )
+      : env(env),
+        deferred(Napi::Promise::Deferred::New(env)),
+        handle(std::move(handle)),
+        indices(std::move(indices)),
+        options(options),
+        concurrency(std::max<size_t>(1, concurrency)),
+        priority(priority),
+        callback(Napi::Persistent(callback)),
+        cancel(std::move(cancel)),
+        dispatcher(Dispatcher::instance(env)),
+        pool(WorkerPool::instance()) {}
+
+  /* the batch deletes itself once its promise is settled */
+  auto start() -> Napi::Promise {
+    auto promise = deferred.Promise();
+    while (in_flight < concurrency && schedule()) {
+    }
+    settle_if_done();
+    return promise;
+  }
+
+ private:
+  using Result = std::shared_ptr<RenderResult>;
+
+  Napi::Env env;
+  Napi::Promise::Deferred deferred;
+  BankHandle handle;
+  std::vector<int> indices;
+  RenderOptions options;
+  size_t concurrency;
+  int priority;
+  Napi::FunctionReference callback;
+  std::shared_ptr<CancelToken> cancel;
+  std::shared_ptr<Dispatcher> dispatcher;
+  std::shared_ptr<WorkerPool> pool;
+
+  size_t next = 0;
+  size_t in_flight = 0;
+  bool failed = false;
+
+  /* queues the next sub-song, false once there is none left */
+  auto schedule() -> bool {
+    if (failed || next >= indices.size()) {
+      return false;
+    }
+    auto stream_index = indices[next++];
+
+    ++in_flight;
+    dispatcher->retain(env);
+    auto submitted = pool->submit(
+        [this, bank = handle.bank, stream_index, submitted = RenderStats::Clock::now()]() {
+          auto queue_ms = RenderStats::elapsed_ms(submitted);
+          // called once, here or later from another thread when the render waits for memory
+          VGMStreamSubSong::render_cached(
+              bank,
+              stream_index,
+              options,
+              cancel,
+              true,
+              priority,
+              [this, stream_index, queue_ms](auto *rendered, auto *failure) {
+                Result result(rendered);
+                std::string error_message = failure != nullptr ? failure : "";
+                if (result && result->stats) {
+                  result->stats->queue_ms = queue_ms;
+                }
+                dispatcher->dispatch([this, stream_index, result, error_message](Napi::Env env) {
+                  complete(stream_index, result, error_message.c_str());
+                });
+              }
+          );
+        },
+        priority
+    );
+    if (!submitted) {
+      dispatcher->release(env);
+      --in_flight;
+      report(stream_index, nullptr, "render queue is full");
+    }
+    return true;
   }
 
-  static Napi::FunctionReference *constructor;
+  void complete(const int stream_index, const Result &result, const char *error_message) {
+    --in_flight;
+    report(stream_index, result, error_message);
+    while (in_flight < concurrency && schedule()) {
+    }
+    settle_if_done();
+  }
+
+  void report(const int stream_index, const Result &result, const char *error_message) {
+    if (!failed) {
+      auto index = Napi::Number::New(env, stream_index);
+      if (result) {
+        callback.Call({env.Null(), index, result->to_value(env)});
+      } else {
+        callback.Call({Napi::Error::New(env, error_message).Value(), index});
+      }
+      /* a throwing callback stops the batch, what is already running is dropped */
+      if (env.IsExceptionPending()) {
+        failed = true;
+        deferred.Reject(env.GetAndClearPendingException().Value());
+      }
+    }
+  }
+
+  void settle_if_done() {
+    if (in_flight > 0 || (!failed && next < indices.size())) {
+      return;
+    }
+    if (!failed) {
+      deferred.Resolve(env.Undefined());
+    }
+    delete this;
+  }
 };
 
-Napi::FunctionReference *VGMStreamSubSong::constructor = nullptr;
+using SubSongList = std::vector<std::optional<vgmstream_info>>;
+
+/* the catalogue fields of every sub-song, null for the ones that fail to open */
+auto sub_song_list_to_value(Napi::Env env, const SubSongList &list) -> Napi::Value {
+  auto $ = Helper(env);
+
+  return $.array<Napi::Value>(list.size(), [&](const size_t i) -> Napi::Value {
+    if (!list[i]) {
+      return $.null();
+    }
+    const auto &bank_info = *list[i];
+
+    return $.object([&](auto meta) {
+      meta["index"] = i + 1;
+      meta["name"] = bank_info.stream_info.name;
+      meta["sampleRate"] = bank_info.sample_rate;
+      meta["channels"] = bank_info.channels;
+      meta["numberOfSamples"] = bank_info.num_samples;
+      meta["encoding"] = bank_info.encoding;
+      if (bank_info.loop_info.end > bank_info.loop_info.start) {
+        meta["loopStart"] = bank_info.loop_info.start;
+        meta["loopEnd"] = bank_info.loop_info.end;
+      }
+    });
+  });
+}
 
 class VGMStream : public Napi::ObjectWrap<VGMStream> {
  private:
   const Napi::CallbackInfo *info = nullptr;
   Helper $;
 
-  Napi::Reference<NapiBuffer> buffer_ref;
-  std::string filename;
+  BankHandle handle;
 
  public:
   explicit VGMStream(const Napi::CallbackInfo &info) : Napi::ObjectWrap<VGMStream>(info), info(&info), $(info.Env()) {
+    auto options = obtain_arg<Napi::Object>(info, 2, Napi::Object::New(info.Env()));
+    auto companion_buffers = Napi::Array::New($.env);
+
+    if (info[0].IsString()) {
+      // vgmstream goes by the extension, so the path itself is the default name
+      auto path = info[0].As<Napi::String>();
+      auto filename = obtain_arg<Napi::String>(info, 1, path);
+      auto companions = obtain_companions(options, companion_buffers, Companions::dirname(path.Utf8Value()));
+      if ($.env.IsExceptionPending()) {
+        return;
+      }
+      this->handle = BankHandle::from_file(path.Utf8Value(), filename.Utf8Value(), companions);
+      if (!this->handle.bank) {
+        $.throws(("failed to map " + path.Utf8Value()).c_str());
+        return;
+      }
+      this->handle.pin(companion_buffers);
+      apply_pool_size(options);
+      return;
+    }
+
     auto buffer = obtain_arg<NapiBuffer>(info, 0);
     auto filename = obtain_arg<Napi::String>(info, 1, $.string("default.bank"));
-    this->filename = filename.Utf8Value();
-    this->buffer_ref = Napi::Reference<NapiBuffer>::New(buffer, 1);
+    auto companions = obtain_companions(options, companion_buffers, "");
+    if ($.env.IsExceptionPending()) {
+      return;
+    }
+    this->handle = BankHandle::from_buffer(buffer, filename.Utf8Value(), companions);
+    this->handle.pin(companion_buffers);
+    apply_pool_size(options);
+  }
+
+  /* the `decoderPoolSize` option, idle decoders the bank keeps around for re-renders */
+  void apply_pool_size(const Napi::Object &options) {
+    auto size = obtain_option(options, "decoderPoolSize", Napi::Number::New($.env, DecoderPool::DefaultCapacity));
+    if (size.Int64Value() < 0) {
+      $.throws("decoderPoolSize should not be negative");
+      return;
+    }
+    handle.bank->set_pool_capacity(size.Int64Value());
   }
 
   static auto get_version(const Napi::CallbackInfo &info) -> Napi::Value {
@@ -245,16 +1352,276 @@ class VGMStream : public Napi::ObjectWrap<VGMStream> {
     });
   }
 
+  static auto configure(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto $ = Helper(info.Env());
+    auto options = obtain_arg<Napi::Object>(info, 0);
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+
+    auto pool = WorkerPool::instance();
+    auto threads = obtain_option(options, "threads", Napi::Number::New($.env, pool->size())).Int64Value();
+    auto max_queue = obtain_option(options, "maxQueue", Napi::Number::New($.env, pool->max_queue())).Int64Value();
+    if (threads <= 0 || max_queue < 0) {
+      return $.throws("threads should be positive and maxQueue should not be negative");
+    }
+    if (static_cast<size_t>(threads) != pool->size() || static_cast<size_t>(max_queue) != pool->max_queue()) {
+      WorkerPool::configure(threads, max_queue);
+    }
+
+    // any cache option starts over with an empty cache
+    auto cache = RenderCache::instance();
+    auto cache_bytes = obtain_option<Napi::Number>(options, "cacheBytes");
+    auto cache_directory = obtain_option<Napi::String>(options, "cacheDirectory");
+    auto cache_spill_bytes = obtain_option<Napi::Number>(options, "cacheSpillBytes");
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+    if (cache_bytes || cache_directory || cache_spill_bytes) {
+      auto max_bytes = cache_bytes ? cache_bytes->Int64Value() : static_cast<int64_t>(cache->budget());
+      auto max_spill_bytes = cache_spill_bytes ? cache_spill_bytes->DoubleValue() : cache->spill_budget();
+      if (max_bytes < 0 || max_spill_bytes < 0) {
+        return $.throws("cacheBytes and cacheSpillBytes should not be negative");
+      }
+      RenderCache::configure(
+          max_bytes,
+          cache_directory ? cache_directory->Utf8Value() : cache->spill_directory(),
+          max_spill_bytes >= static_cast<double>(SIZE_MAX) ? SIZE_MAX : static_cast<size_t>(max_spill_bytes)
+      );
+    }
+
+    auto budget = MemoryBudget::instance();
+    auto memory_budget = obtain_option<Napi::Number>(options, "memoryBudget");
+    auto memory_queue = obtain_option<Napi::Number>(options, "memoryQueue");
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+    if (memory_budget || memory_queue) {
+      auto max_bytes = memory_budget ? memory_budget->DoubleValue() : static_cast<double>(budget->budget());
+      auto max_waiting = memory_queue ? memory_queue->DoubleValue() : static_cast<double>(budget->queue_limit());
+      if (max_bytes < 0 || max_waiting < 0) {
+        return $.throws("memoryBudget and memoryQueue should not be negative");
+      }
+      MemoryBudget::configure(
+          max_bytes >= static_cast<double>(SIZE_MAX) ? SIZE_MAX : static_cast<size_t>(max_bytes),
+          max_waiting >= static_cast<double>(SIZE_MAX) ? SIZE_MAX : static_cast<size_t>(max_waiting)
+      );
+    }
+
+    // loads the file again even when it is the same one, an empty path turns the index off
+    if (auto index_file = obtain_option<Napi::String>(options, "indexFile")) {
+      auto path = index_file->Utf8Value();
+      BankIndex::configure(path);
+      if (!path.empty() && !BankIndex::instance()->enabled()) {
+        return $.throws(("failed to open the index file " + path).c_str());
+      }
+    }
+
+    return $.undefined();
+  }
+
+  static auto get_stats(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto $ = Helper(info.Env());
+    auto cache = RenderCache::instance()->stats();
+    auto index = BankIndex::instance()->stats();
+    auto memory = MemoryBudget::instance()->stats();
+    auto pool = WorkerPool::instance();
+    auto &counters = RenderCounters::instance();
+
+    return $.object([&](auto stats) {
+      stats["renders"] = $.object([&](auto render_stats) {
+        render_stats["threads"] = static_cast<double>(pool->size());
+        render_stats["active"] = static_cast<double>(pool->active());
+        render_stats["queued"] = static_cast<double>(pool->queued());
+        render_stats["completed"] = static_cast<double>(counters.renders.load(std::memory_order_relaxed));
+        render_stats["samplesDecoded"] = static_cast<double>(counters.samples_decoded.load(std::memory_order_relaxed));
+        render_stats["bytesAllocated"] = static_cast<double>(counters.bytes_allocated.load(std::memory_order_relaxed));
+        render_stats["resizes"] = static_cast<double>(counters.resizes.load(std::memory_order_relaxed));
+      });
+      stats["cache"] = $.object([&](auto cache_stats) {
+        cache_stats["hits"] = static_cast<double>(cache.hits);
+        cache_stats["misses"] = static_cast<double>(cache.misses);
+        cache_stats["evictions"] = static_cast<double>(cache.evictions);
+        cache_stats["spills"] = static_cast<double>(cache.spills);
+        cache_stats["spillHits"] = static_cast<double>(cache.spill_hits);
+        cache_stats["entries"] = static_cast<double>(cache.entries);
+        cache_stats["bytes"] = static_cast<double>(cache.bytes);
+        cache_stats["spilledEntries"] = static_cast<double>(cache.spilled_entries);
+        cache_stats["spilledBytes"] = static_cast<double>(cache.spilled_bytes);
+      });
+      stats["memory"] = $.object([&](auto memory_stats) {
+        memory_stats["budget"] = static_cast<double>(memory.budget);
+        memory_stats["inUse"] = static_cast<double>(memory.in_use);
+        memory_stats["peak"] = static_cast<double>(memory.peak);
+        memory_stats["waiting"] = static_cast<double>(memory.waiting);
+        memory_stats["admitted"] = static_cast<double>(memory.admitted);
+        memory_stats["rejected"] = static_cast<double>(memory.rejected);
+      });
+      stats["index"] = $.object([&](auto index_stats) {
+        index_stats["hits"] = static_cast<double>(index.hits);
+        index_stats["misses"] = static_cast<double>(index.misses);
+        index_stats["appends"] = static_cast<double>(index.appends);
+        index_stats["banks"] = static_cast<double>(index.banks);
+        index_stats["subSongs"] = static_cast<double>(index.sub_songs);
+      });
+    });
+  }
+
   auto get_sub_song_count(const Napi::CallbackInfo &info) -> Napi::Value {
-    auto vgmstream = vgmstream_from_buffer(this->buffer_ref.Value(), 1, this->filename);
+    auto count = handle.bank->sub_song_count();
+    if (count < 0) {
+      return $.throws("failed to parse the bank");
+    }
+
+    return $.number(count);
+  }
+
+  auto list_sub_songs(const Napi::CallbackInfo &info) -> Napi::Value {
+    if (handle.bank->sub_song_count() < 0) {
+      return $.throws("failed to parse the bank");
+    }
+
+    return sub_song_list_to_value($.env, handle.bank->describe_all());
+  }
+
+  auto probe(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto promise = $.async<SubSongList>(
+        [bank = handle.bank](auto resolve, auto reject) {
+          if (bank->sub_song_count() < 0) {
+            reject("failed to parse the bank");
+            return;
+          }
+          resolve(new SubSongList(bank->describe_all()));
+        },
+        [](auto env, auto value) { return sub_song_list_to_value(env, *value); }
+    );
+    handle.retain(promise);
 
-    return $.number(vgmstream->num_streams);
+    return promise;
   }
 
   auto select_sub_song(const Napi::CallbackInfo &info) -> Napi::Value {
     auto stream_index = info[0];
 
-    return VGMStreamSubSong::constructor->New({this->buffer_ref.Value(), stream_index, $.string(filename)});
+    return AddonData::of($.env).sub_song.New({Napi::External<BankHandle>::New($.env, &handle), stream_index});
+  }
+
+  /* selectSubSong with the header parse and codec init done on the pool, the decoder is pooled for the
+   * first render and the description cached for `info` */
+  auto select_sub_song_async(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto stream_index = obtain_arg<Napi::Number>(info, 0);
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+
+    auto promise = $.async<int>(
+        [bank = handle.bank, index = stream_index.Int32Value()](auto resolve, auto reject) {
+          if (!bank->describe(index)) {
+            reject(OpenFailure);
+            return;
+          }
+          resolve(new int(index));
+        },
+        [this](auto env, auto index) {
+          return AddonData::of(env).sub_song.New(
+              {Napi::External<BankHandle>::New(env, &handle), Napi::Number::New(env, *index)}
+          );
+        }
+    );
+    retain_until_collected(this, promise);
+    return promise;
+  }
+
+  /* keeps `stream` (and so its handle) alive until `promise` is collected, whether it resolves or not */
+  static void retain_until_collected(VGMStream *stream, Napi::Promise &promise) {
+    stream->Ref();
+    auto finalizer = [stream](Napi::Env env, void *data) { stream->Unref(); };
+    promise.AddFinalizer<decltype(finalizer), void>(finalizer, nullptr);
+  }
+
+  /* the constructor's arguments, resolving once the bank is parsed on the pool so that neither subSongCount
+   * nor the first sub-song parse on the JS thread */
+  static auto open(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto $ = Helper(info.Env());
+    std::vector<napi_value> args;
+    for (size_t i = 0; i < info.Length(); ++i) {
+      args.push_back(info[i]);
+    }
+    auto object = AddonData::of($.env).vgmstream.New(args);
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+
+    auto *stream = VGMStream::Unwrap(object);
+    auto promise = $.async<int>(
+        [bank = stream->handle.bank](auto resolve, auto reject) {
+          auto count = bank->sub_song_count();
+          if (count < 0) {
+            reject("failed to parse the bank");
+            return;
+          }
+          resolve(new int(count));
+        },
+        [stream](auto env, auto count) { return stream->Value(); }
+    );
+    retain_until_collected(stream, promise);
+    return promise;
+  }
+
+  auto render_each(const Napi::CallbackInfo &info) -> Napi::Value {
+    auto options = obtain_arg<Napi::Object>(info, 0, Napi::Object::New(info.Env()));
+    if (!info[1].IsFunction()) {
+      return $.throws("expect arg[1] to be a function but not");
+    }
+    auto callback = info[1].As<Napi::Function>();
+
+    auto render_options = obtain_bounded_render_options(options);
+    auto priority = obtain_option(options, "priority", Napi::Number::New($.env, 0)).Int32Value();
+    auto concurrency = obtain_option(options, "concurrency", Napi::Number::New($.env, WorkerPool::instance()->size()));
+    auto cancel = obtain_cancel_token(options);
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+
+    if (!(concurrency.DoubleValue() >= 1)) {
+      Napi::RangeError::New($.env, "concurrency should be a positive number").ThrowAsJavaScriptException();
+      return $.undefined();
+    }
+
+    auto count = handle.bank->sub_song_count();
+    if (count < 0) {
+      return $.throws("failed to parse the bank");
+    }
+    auto last = std::max(count, 1);
+    auto selected = obtain_option<Napi::Array>(options, "indices");
+    if ($.env.IsExceptionPending()) {
+      return $.undefined();
+    }
+    std::vector<int> indices;
+    if (selected) {
+      for (uint32_t i = 0; i < selected->Length(); ++i) {
+        Napi::Value index = selected->Get(i);
+        auto value = index.IsNumber() ? index.As<Napi::Number>().DoubleValue() : 0.0;
+        if (!index.IsNumber() || value != std::floor(value) || value < 1 || value > last) {
+          Napi::RangeError::New($.env, "indices should hold integers from 1 to " + std::to_string(last))
+              .ThrowAsJavaScriptException();
+          return $.undefined();
+        }
+        indices.push_back(static_cast<int>(value));
+      }
+    } else {
+      for (int index = 1; index <= last; ++index) {
+        indices.push_back(index);
+      }
+    }
+
+    auto *batch = new Batch(
+        $.env, handle, std::move(indices), render_options, static_cast<size_t>(concurrency.Int64Value()), priority,
+        callback, cancel
+    );
+    auto promise = batch->start();
+    watch_abort_signal(options, cancel, promise);
+    return promise;
   }
 
   static auto init(Napi::Env env, Napi::Object exports) {
@@ -263,19 +1630,28 @@ class VGMStream : public Napi::ObjectWrap<VGMStream> {
         "VGMStream",
         {
             StaticAccessor<&VGMStream::get_version>("version"),
+            StaticMethod<&VGMStream::configure>("configure"),
+            StaticAccessor<&VGMStream::get_stats>("stats"),
+            StaticMethod<&VGMStream::open>("open"),
             InstanceAccessor<&VGMStream::get_sub_song_count>("subSongCount"),
+            InstanceMethod<&VGMStream::list_sub_songs>("listSubSongs"),
+            InstanceMethod<&VGMStream::probe>("probe"),
             InstanceMethod<&VGMStream::select_sub_song>("selectSubSong"),
+            InstanceMethod<&VGMStream::select_sub_song_async>("selectSubSongAsync"),
+            InstanceMethod<&VGMStream::render_each>("renderEach"),
         }
     );
-    auto *constructor = new Napi::FunctionReference();
-    *constructor = Napi::Persistent(vgmstream_class);
+    AddonData::of(env).vgmstream = Napi::Persistent(vgmstream_class);
     exports["VGMStream"] = vgmstream_class;
   }
 };
 
+/* runs once per environment, every worker thread loading the addon gets its own classes */
 static auto Init(Napi::Env env, Napi::Object exports) -> Napi::Object {
+  AddonData::attach(env);
   VGMStream::init(env, exports);
-  VGMStreamSubSong::init(env);
+  VGMStreamSubSong::init(env, exports);
+  VGMStreamReader::init(env, exports);
   return exports;
 }
 
@@ -0,0 +1,116 @@
+#ifndef SRC_MAPPED_FILE_HPP_
+#define SRC_MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* read-only view of a whole file, paged in lazily by the kernel and shared with every other process mapping it */
+class MappedFile {
+ public:
+  MappedFile(const MappedFile &) = delete;
+  auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+  ~MappedFile() {
+    if (mapped == nullptr) {
+      return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+#else
+    munmap(mapped, length);
+#endif
+  }
+
+  /* maps `path`, returns nullptr when the file cannot be opened or mapped */
+  static auto open(const std::string &path) -> std::shared_ptr<MappedFile> {
+    auto file = std::shared_ptr<MappedFile>(new MappedFile());
+#ifdef _WIN32
+    auto wide_length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    if (wide_length <= 0) {
+      return nullptr;
+    }
+    std::wstring wide_path(wide_length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide_path.data(), wide_length);
+
+    auto handle = CreateFileW(
+        wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    if (handle == INVALID_HANDLE_VALUE) {
+      return nullptr;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+      CloseHandle(handle);
+      return nullptr;
+    }
+    file->length = static_cast<size_t>(size.QuadPart);
+
+    // an empty file cannot be mapped, it simply has no bytes to serve
+    if (file->length > 0) {
+      auto mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping != nullptr) {
+        file->mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(handle);
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat status {};
+    if (fstat(fd, &status) != 0) {
+      ::close(fd);
+      return nullptr;
+    }
+    file->length = static_cast<size_t>(status.st_size);
+
+    // an empty file cannot be mapped, it simply has no bytes to serve
+    if (file->length > 0) {
+      auto *mapped = mmap(nullptr, file->length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        file->mapped = mapped;
+      }
+    }
+    ::close(fd);
+#endif
+
+    if (file->length > 0 && file->mapped == nullptr) {
+      return nullptr;
+    }
+    return file;
+  }
+
+  [[nodiscard]]
+  auto data() const -> const uint8_t * {
+    return static_cast<const uint8_t *>(mapped);
+  }
+
+  [[nodiscard]]
+  auto size() const -> size_t {
+    return length;
+  }
+
+ private:
+  MappedFile() = default;
+
+  void *mapped = nullptr;
+  size_t length = 0;
+};
+
+#endif  // SRC_MAPPED_FILE_HPP_
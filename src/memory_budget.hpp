@@ -0,0 +1,256 @@
+#ifndef SRC_MEMORY_BUDGET_HPP_
+#define SRC_MEMORY_BUDGET_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* caps the bytes whole renders hold at once: each reserves its estimated footprint before decoding and waits
+ * its turn, in arrival order and without holding a thread, while the rest of the budget is in use; admits
+ * everything until given a budget */
+class MemoryBudget : public std::enable_shared_from_this<MemoryBudget> {
+ public:
+  static constexpr auto TooLargeFailure = "render needs more memory than the whole memory budget";
+  static constexpr auto BusyFailure = "memory budget exhausted";
+  static constexpr auto QueueFullFailure = "memory queue is full";
+
+  struct Stats {
+    size_t budget = 0;
+    size_t in_use = 0;
+    size_t peak = 0;
+    size_t waiting = 0;
+    uint64_t admitted = 0;
+    uint64_t rejected = 0;
+  };
+
+  /* bytes of the budget, given back when destroyed; an empty one holds nothing */
+  class Reservation {
+   public:
+    Reservation() = default;
+    Reservation(std::shared_ptr<MemoryBudget> budget, const size_t bytes) : budget(std::move(budget)), bytes(bytes) {}
+
+    Reservation(Reservation &&other) noexcept : budget(std::move(other.budget)), bytes(other.bytes) {}
+    auto operator=(Reservation &&other) noexcept -> Reservation & {
+      if (this != &other) {
+        release();
+        budget = std::move(other.budget);
+        bytes = other.bytes;
+      }
+      return *this;
+    }
+    Reservation(const Reservation &) = delete;
+    auto operator=(const Reservation &) -> Reservation & = delete;
+
+    ~Reservation() { release(); }
+
+   private:
+    std::shared_ptr<MemoryBudget> budget;
+    size_t bytes = 0;
+
+    void release() {
+      if (budget) {
+        budget->release(bytes);
+        budget.reset();
+      }
+    }
+  };
+
+  /* `max_waiting` renders may wait for memory at once, the next ones are rejected */
+  explicit MemoryBudget(const size_t max_bytes = 0, const size_t max_waiting = SIZE_MAX)
+      : max_bytes(max_bytes), max_waiting(max_waiting) {}
+
+  MemoryBudget(const MemoryBudget &) = delete;
+  auto operator=(const MemoryBudget &) -> MemoryBudget & = delete;
+
+  [[nodiscard]]
+  auto enabled() const -> bool {
+    return max_bytes > 0;
+  }
+
+  [[nodiscard]]
+  auto budget() const -> size_t {
+    return max_bytes;
+  }
+
+  [[nodiscard]]
+  auto queue_limit() const -> size_t {
+    return max_waiting;
+  }
+
+  /* hands a queued reservation over, or nullopt once the waiter was cancelled; must not throw */
+  using Admitted = std::function<void(std::optional<Reservation>)>;
+
+  /* `bytes` of the budget when they fit now; otherwise nullopt, with the reason in `failure` when they can never
+   * fit, or `wait` is false or the queue is full. Else (with no reason) they wait their turn without holding
+   * the caller: the budget's own thread passes them to `admitted` once they fit, or passes nullopt once
+   * `cancelled` returns true, which it polls while they wait */
+  auto reserve(
+      const size_t bytes,
+      const bool wait,
+      std::function<bool()> cancelled,
+      Admitted admitted,
+      const char **failure
+  ) -> std::optional<Reservation> {
+    *failure = nullptr;
+    if (!enabled()) {
+      return Reservation{};
+    }
+
+    std::lock_guard lock(mutex);
+    auto reject = [&](const char *reason) {
+      ++counters.rejected;
+      *failure = reason;
+      return std::nullopt;
+    };
+    if (bytes > max_bytes) {
+      return reject(TooLargeFailure);
+    }
+    if (waiting.empty() && counters.in_use + bytes <= max_bytes) {
+      return admit(bytes);
+    }
+    if (!wait) {
+      return reject(BusyFailure);
+    }
+    if (waiting.size() >= max_waiting) {
+      return reject(QueueFullFailure);
+    }
+
+    waiting.push_back(Waiter{bytes, std::move(cancelled), std::move(admitted)});
+    if (!admitting) {
+      try {
+        std::thread([budget = shared_from_this()] { budget->admit_waiting(); }).detach();
+      } catch (...) {
+        waiting.pop_back();
+        throw;
+      }
+      admitting = true;
+    }
+    condition.notify_all();
+    return std::nullopt;
+  }
+
+  [[nodiscard]]
+  auto stats() -> Stats {
+    std::lock_guard lock(mutex);
+    auto stats = counters;
+    stats.budget = max_bytes;
+    stats.waiting = waiting.size();
+    return stats;
+  }
+
+  /* process-wide budget shared by every render */
+  static auto instance() -> std::shared_ptr<MemoryBudget> {
+    std::lock_guard lock(shared_mutex());
+    auto &budget = shared_budget();
+    if (!budget) {
+      budget = std::make_shared<MemoryBudget>();
+    }
+    return budget;
+  }
+
+  /* swaps in a new budget, renders admitted or waiting under the old one finish against it */
+  static void configure(const size_t max_bytes, const size_t max_waiting) {
+    auto budget = std::make_shared<MemoryBudget>(max_bytes, max_waiting);
+    std::lock_guard lock(shared_mutex());
+    shared_budget().swap(budget);
+  }
+
+ private:
+  static constexpr auto CancelPollInterval = std::chrono::milliseconds(20);
+
+  const size_t max_bytes;
+  const size_t max_waiting;
+
+  struct Waiter {
+    size_t bytes;
+    std::function<bool()> cancelled;
+    Admitted admitted;
+  };
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<Waiter> waiting;
+  // whether the thread behind admit_waiting() runs
+  bool admitting = false;
+  Stats counters;
+
+  /* called with the lock held */
+  auto admit(const size_t bytes) -> Reservation {
+    counters.in_use += bytes;
+    counters.peak = std::max(counters.peak, counters.in_use);
+    ++counters.admitted;
+    return Reservation{shared_from_this(), bytes};
+  }
+
+  /* the queue's thread: hands reservations out in arrival order as releases make room, so a long render is not
+   * starved by a run of short ones, and drops cancelled waiters wherever they are in line; leaves once the
+   * queue is empty, and keeps the budget alive until then */
+  void admit_waiting() {
+    std::unique_lock lock(mutex);
+    while (!waiting.empty()) {
+      std::vector<std::pair<Admitted, std::optional<Reservation>>> ready;
+      for (auto waiter = waiting.begin(); waiter != waiting.end();) {
+        if (waiter->cancelled && waiter->cancelled()) {
+          ready.emplace_back(std::move(waiter->admitted), std::nullopt);
+          waiter = waiting.erase(waiter);
+        } else {
+          ++waiter;
+        }
+      }
+      while (!waiting.empty() && counters.in_use + waiting.front().bytes <= max_bytes) {
+        ready.emplace_back(std::move(waiting.front().admitted), admit(waiting.front().bytes));
+        waiting.pop_front();
+      }
+
+      if (!ready.empty()) {
+        lock.unlock();
+        for (auto &[admitted, reservation] : ready) {
+          admitted(std::move(reservation));
+        }
+        // reservations the callbacks left behind are given back without the lock
+        ready.clear();
+        lock.lock();
+        continue;
+      }
+      auto cancellable = std::any_of(waiting.begin(), waiting.end(), [](const auto &waiter) {
+        return static_cast<bool>(waiter.cancelled);
+      });
+      if (cancellable) {
+        condition.wait_for(lock, CancelPollInterval);
+      } else {
+        condition.wait(lock);
+      }
+    }
+    admitting = false;
+  }
+
+  void release(const size_t bytes) {
+    {
+      std::lock_guard lock(mutex);
+      counters.in_use -= bytes;
+    }
+    condition.notify_all();
+  }
+
+  static auto shared_mutex() -> std::mutex & {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static auto shared_budget() -> std::shared_ptr<MemoryBudget> & {
+    static std::shared_ptr<MemoryBudget> budget;
+    return budget;
+  }
+};
+
+#endif  // SRC_MEMORY_BUDGET_HPP_
@@ -0,0 +1,583 @@
+#ifndef SRC_RENDER_HPP_
+#define SRC_RENDER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./analysis.hpp"
+#include "./endian.hpp"
+#include "./flac_encoder.hpp"
+#include "./resampler.hpp"
+#include "./seek.hpp"
+
+extern "C" {
+#include "vgmstream/cli/wav_utils.h"
+#include "vgmstream/src/base/mixing.h"
+#include "vgmstream/src/base/plugins.h"
+#include "vgmstream/src/streamtypes.h"
+#include "vgmstream/src/vgmstream.h"
+}
+
+enum class OutputFormat {
+  Wav,    /* 16-bit PCM .wav file */
+  S16,    /* raw interleaved little-endian int16 */
+  F32,    /* raw interleaved little-endian float32 */
+  Planar, /* one native-endian float32 plane per channel */
+  Flac    /* 16-bit FLAC stream, encoded block by block */
+};
+
+/* -1.0 to 1.0 floats, written as plain loops the compiler can vectorise */
+inline void samples_to_float(const sample_t *src, float *dst, const size_t count) {
+  constexpr float scale = 1.0F / 32768.0F;
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = static_cast<float>(src[i]) * scale;
+  }
+}
+
+template <int Channels>
+void deinterleave_to_float(const sample_t *src, uint8_t *dst, const size_t plane_stride, const size_t samples) {
+  constexpr float scale = 1.0F / 32768.0F;
+  for (int channel = 0; channel < Channels; ++channel) {
+    auto *plane = reinterpret_cast<float *>(dst + channel * plane_stride);
+    for (size_t i = 0; i < samples; ++i) {
+      plane[i] = static_cast<float>(src[i * Channels + channel]) * scale;
+    }
+  }
+}
+
+inline void deinterleave_to_float(
+    const sample_t *src, uint8_t *dst, const size_t plane_stride, const int channels, const size_t samples
+) {
+  switch (channels) {
+    case 1:
+      samples_to_float(src, reinterpret_cast<float *>(dst), samples);
+      return;
+    case 2:
+      deinterleave_to_float<2>(src, dst, plane_stride, samples);
+      return;
+    default: {
+      constexpr float scale = 1.0F / 32768.0F;
+      for (int channel = 0; channel < channels; ++channel) {
+        auto *plane = reinterpret_cast<float *>(dst + channel * plane_stride);
+        for (size_t i = 0; i < samples; ++i) {
+          plane[i] = static_cast<float>(src[i * channels + channel]) * scale;
+        }
+      }
+    }
+  }
+}
+
+/* floats back to int16, rounded and clamped since resampling can overshoot full scale */
+inline void float_to_samples(const float *src, sample_t *dst, const size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = static_cast<sample_t>(std::clamp(std::lround(src[i] * 32768.0F), -32768L, 32767L));
+  }
+}
+
+inline void deinterleave_float(
+    const float *src, uint8_t *dst, const size_t plane_stride, const int channels, const size_t samples
+) {
+  for (int channel = 0; channel < channels; ++channel) {
+    auto *plane = reinterpret_cast<float *>(dst + channel * plane_stride);
+    for (size_t i = 0; i < samples; ++i) {
+      plane[i] = src[i * channels + channel];
+    }
+  }
+}
+
+/* how a sub-song gets rendered, parsed from the JS options object */
+struct RenderOptions {
+  OutputFormat format = OutputFormat::Wav;
+
+  /* window to render, in samples or in seconds (samples win when both are given), end excluded */
+  std::optional<int32_t> start_sample;
+  std::optional<int32_t> end_sample;
+  std::optional<double> start_time;
+  std::optional<double> end_time;
+
+  /* looping, mapped onto vgmstream's play config which is left alone unless one of these is set */
+  std::optional<double> loop_count;
+  std::optional<double> fade_time;
+  std::optional<double> fade_delay;
+  bool ignore_loop = false;
+  bool force_loop = false;
+  bool ignore_fade = false;
+  bool play_forever = false;
+
+  /* write the loop points into a .wav smpl chunk */
+  bool smpl_chunk = false;
+
+  /* channel mixing done by vgmstream as it decodes, in this order: keep the channels in `channel_mask`
+   * (bit n for channel n), fold layers of `layer_channels` channels together (only the layers in `layer_mask`
+   * when set), then downmix to `downmix` channels (1 or 2); zero leaves a step out */
+  uint32_t channel_mask = 0;
+  int layer_channels = 0;
+  uint32_t layer_mask = 0;
+  int downmix = 0;
+
+  [[nodiscard]]
+  auto mixes() const -> bool {
+    return channel_mask != 0 || layer_channels > 0 || downmix > 0;
+  }
+
+  /* output rate, 0 keeps the sub-song's own; the window above stays in samples at the sub-song's rate */
+  int sample_rate = 0;
+  Resampler::Quality resample_quality = Resampler::Quality::Medium;
+
+  /* pieces a whole render may be cut into and decoded at once, where the codec and layout seek exactly;
+   * 0 or 1 renders serially */
+  int segments = 0;
+
+  /* measure the output as it is rendered; `analysis_only` hands out the figures without the data */
+  std::optional<AnalysisOptions> analysis;
+  bool analysis_only = false;
+
+  /* return timings and allocation figures along with the data, leaves the output alone */
+  bool collect_stats = false;
+
+  [[nodiscard]]
+  auto configures_playback() const -> bool {
+    return loop_count || fade_time || fade_delay || ignore_loop || force_loop || ignore_fade || play_forever;
+  }
+
+  /* tells decoders apart by what the play config and the mixing did to them, only equal keys may share a
+   * pooled decoder */
+  [[nodiscard]]
+  auto setup_key() const -> std::string {
+    std::string key;
+    char part[128];
+    if (configures_playback()) {
+      snprintf(
+          part, sizeof(part), "loop:%a,%a,%a,%d%d%d%d;", loop_count.value_or(1.0), fade_time.value_or(0.0),
+          fade_delay.value_or(0.0), ignore_loop, force_loop, ignore_fade, play_forever
+      );
+      key += part;
+    }
+    if (mixes()) {
+      snprintf(part, sizeof(part), "mix:%x,%d,%x,%d;", channel_mask, layer_channels, layer_mask, downmix);
+      key += part;
+    }
+    return key;
+  }
+
+  /* everything that changes the rendered bytes, for the render cache */
+  [[nodiscard]]
+  auto cache_key() const -> std::string {
+    char key[192];
+    snprintf(
+        key, sizeof(key), "%d:%d-%d:%a-%a:%d:%d/%d:", static_cast<int>(format), start_sample.value_or(-1),
+        end_sample.value_or(-1), start_time.value_or(-1.0), end_time.value_or(-1.0), smpl_chunk, sample_rate,
+        static_cast<int>(resample_quality)
+    );
+    return key + setup_key();
+  }
+
+  /* only a stream can hand out a render that never ends */
+  [[nodiscard]]
+  auto unbounded() const -> bool {
+    return play_forever && !end_sample && !end_time;
+  }
+};
+
+/* lets a render be given up between blocks, by an abort from JS or by a deadline */
+class CancelToken {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit CancelToken(const std::optional<Clock::time_point> deadline = std::nullopt) : deadline(deadline) {}
+
+  /* may be called from any thread */
+  void abort() { aborted.store(true, std::memory_order_relaxed); }
+
+  [[nodiscard]]
+  auto tripped() const -> bool {
+    return aborted.load(std::memory_order_relaxed) || (deadline && Clock::now() >= *deadline);
+  }
+
+  [[nodiscard]]
+  auto reason() const -> const char * {
+    return aborted.load(std::memory_order_relaxed) ? "render aborted" : "render timed out";
+  }
+
+ private:
+  std::atomic<bool> aborted{false};
+  std::optional<Clock::time_point> deadline;
+};
+
+/* incremental decoder over one VGMSTREAM, shared by whole-file renders and streaming reads */
+class Renderer {
+ public:
+  static constexpr int32_t BlockSamples = 8192;
+  static constexpr size_t HeaderCapacity = 1024;
+
+  /* `prepared` tells that the decoder was already set up for options.setup_key() by an earlier renderer */
+  explicit Renderer(
+      std::shared_ptr<VGMSTREAM> vgmstream_ptr, const RenderOptions &options = {}, const bool prepared = false
+  )
+      : vgmstream_ptr(std::move(vgmstream_ptr)), format(options.format) {
+    auto *vgmstream = this->vgmstream_ptr.get();
+
+    if (!prepared) {
+      set_up(vgmstream, options);
+    }
+
+    /* mixing needs a buffer for the largest block, and decodes at the pre-mixing width before folding */
+    channels = vgmstream->channels;
+    input_channels = vgmstream->channels;
+    vgmstream_mixing_enable(vgmstream, options.mixes() ? BlockSamples : 0, &input_channels, &channels);
+
+    output_rate = vgmstream->sample_rate;
+    if (options.sample_rate > 0 && options.sample_rate != vgmstream->sample_rate) {
+      output_rate = options.sample_rate;
+      resampler = std::make_unique<Resampler>(channels, vgmstream->sample_rate, output_rate, options.resample_quality);
+      resampled.resize(static_cast<size_t>(BlockSamples) * channels);
+    }
+
+    /* int16 output is decoded in place, floats and resampling go through a block of int16 first */
+    if (!decodes_in_place()) {
+      scratch.resize(static_cast<size_t>(BlockSamples) * input_channels);
+    }
+
+    auto total = vgmstream_get_samples(vgmstream);
+    auto start = std::clamp(to_sample(options.start_sample, options.start_time, 0), 0, total);
+    auto end = std::clamp(to_sample(options.end_sample, options.end_time, total), start, total);
+
+    /* only the window gets decoded into the output */
+    if (start > 0 && !seek_exact(vgmstream, start, end)) {
+      seek_vgmstream(vgmstream, start);
+    }
+    window_start = start;
+    window_end = end;
+    source_remaining = end - start;
+    length = to_output(end - start);
+    endless = options.unbounded() && vgmstream_get_play_forever(vgmstream);
+
+    /* loop points are relative to the window, and only make sense when it holds the whole loop */
+    if (options.smpl_chunk && vgmstream->loop_flag && vgmstream->loop_start_sample >= start &&
+        vgmstream->loop_end_sample <= end) {
+      smpl_loop = {to_output(vgmstream->loop_start_sample - start), to_output(vgmstream->loop_end_sample - start)};
+    }
+
+    if (format == OutputFormat::Flac && channels <= FlacEncoder::MaxChannels) {
+      flac = std::make_unique<FlacEncoder>(channels, output_rate, endless ? 0 : length);
+    }
+    if (options.analysis && !endless) {
+      measure = std::make_unique<Analyzer>(channels, output_rate, length, *options.analysis);
+    }
+  }
+
+  /* writes the .wav header for the whole render, returns bytes written (none for raw formats) */
+  auto write_header(uint8_t *dst, const size_t size) const -> size_t {
+    if (format != OutputFormat::Wav) {
+      return 0;
+    }
+    wav_header_t wav = {
+        /* an endless stream claims the largest data chunk a .wav can describe */
+        .sample_count = endless ? static_cast<int32_t>((INT32_MAX - HeaderCapacity) / output_size(1)) : length,
+        .sample_rate = output_rate,
+        .channels = channels,
+        .write_smpl_chunk = smpl_loop.has_value(),
+        .loop_start = smpl_loop ? smpl_loop->first : 0,
+        .loop_end = smpl_loop ? smpl_loop->second : 0
+    };
+    return wav_make_header(dst, size, &wav);
+  }
+
+  [[nodiscard]]
+  auto header_size() const -> size_t {
+    uint8_t scratch[HeaderCapacity];
+    return write_header(scratch, sizeof(scratch));
+  }
+
+  /* exact bytes for the header (if any) plus `samples` samples per channel, with room for the last block
+   * to be decoded at its pre-mixing width */
+  [[nodiscard]]
+  auto chunk_size(const int32_t samples, const bool with_header) const -> size_t {
+    return (with_header ? header_size() : 0) + output_size(samples) + scratch_size(BlockSamples) -
+           output_size(BlockSamples);
+  }
+
+  /* decodes up to max_samples (at most one block) per channel into dst in the output format, returns 0 once
+   * finished; dst must have scratch_size(max_samples) bytes available, planar output writes channel n at
+   * dst + n * plane_stride */
+  auto render(uint8_t *dst, const int32_t max_samples, const size_t plane_stride = 0) -> int32_t {
+    auto to_get = std::min({max_samples, remaining(), BlockSamples});
+    if (to_get <= 0) {
+      return 0;
+    }
+    auto count = static_cast<size_t>(to_get) * channels;
+
+    if (resampler) {
+      render_resampled(dst, to_get, plane_stride);
+      if (!endless) {
+        position += to_get;
+      }
+      return to_get;
+    }
+
+    switch (format) {
+      case OutputFormat::Wav:
+      case OutputFormat::S16:
+        render_vgmstream(reinterpret_cast<sample_t *>(dst), to_get, vgmstream_ptr.get());
+        analyze(reinterpret_cast<sample_t *>(dst), to_get);
+#if SWAP_REQUIRED
+        swap_bytes(reinterpret_cast<sample_t *>(dst), count);
+#endif
+        break;
+      case OutputFormat::F32:
+        render_vgmstream(scratch.data(), to_get, vgmstream_ptr.get());
+        analyze(scratch.data(), to_get);
+        samples_to_float(scratch.data(), reinterpret_cast<float *>(dst), count);
+#if SWAP_REQUIRED
+        swap_bytes(reinterpret_cast<float *>(dst), count);
+#endif
+        break;
+      case OutputFormat::Planar:
+        render_vgmstream(scratch.data(), to_get, vgmstream_ptr.get());
+        analyze(scratch.data(), to_get);
+        deinterleave_to_float(scratch.data(), dst, plane_stride, channels, to_get);
+        break;
+      case OutputFormat::Flac:
+        // native-endian int16 for encoder()
+        render_vgmstream(reinterpret_cast<sample_t *>(dst), to_get, vgmstream_ptr.get());
+        analyze(reinterpret_cast<sample_t *>(dst), to_get);
+        break;
+    }
+
+    if (!endless) {
+      position += to_get;
+    }
+    return to_get;
+  }
+
+  [[nodiscard]]
+  auto remaining() const -> int32_t {
+    return endless ? INT32_MAX : length - position;
+  }
+
+  [[nodiscard]]
+  auto finished() const -> bool {
+    return remaining() <= 0;
+  }
+
+  /* bytes render() needs available at dst for `samples` samples per channel */
+  [[nodiscard]]
+  auto scratch_size(const int32_t samples) const -> size_t {
+    if (!decodes_in_place()) {
+      return output_size(samples);
+    }
+    return static_cast<size_t>(samples) * input_channels * sizeof(sample_t);
+  }
+
+  /* bytes of `samples` rendered samples per channel once written out */
+  [[nodiscard]]
+  auto output_size(const int32_t samples) const -> size_t {
+    return static_cast<size_t>(samples) * channels * sample_size();
+  }
+
+  [[nodiscard]]
+  auto sample_size() const -> size_t {
+    return int16_output() ? sizeof(sample_t) : sizeof(float);
+  }
+
+  [[nodiscard]]
+  auto output_format() const -> OutputFormat {
+    return format;
+  }
+
+  [[nodiscard]]
+  auto output_channels() const -> int {
+    return channels;
+  }
+
+  /* the decoded window, in samples at the sub-song's own rate */
+  [[nodiscard]]
+  auto window() const -> std::pair<int32_t, int32_t> {
+    return {window_start, window_end};
+  }
+
+  /* whether the window can be cut into pieces rendered by other renderers over other decoders of the same
+   * sub-song, each seeking exactly to its piece and writing exactly its own bytes */
+  [[nodiscard]]
+  auto splittable() const -> bool {
+    return !endless && !resampler && !measure && format != OutputFormat::Flac && channels == input_channels &&
+           seeks_exactly(vgmstream_ptr.get(), window_end);
+  }
+
+  /* turns what render() hands out in Flac format into frames, nullptr when FLAC cannot hold the channels */
+  [[nodiscard]]
+  auto encoder() const -> FlacEncoder * {
+    return flac.get();
+  }
+
+  /* what was measured of the output so far, nullptr unless the options asked for analysis */
+  [[nodiscard]]
+  auto analyzer() const -> const Analyzer * {
+    return measure.get();
+  }
+
+ private:
+  std::shared_ptr<VGMSTREAM> vgmstream_ptr;
+  OutputFormat format;
+  int channels;
+  int input_channels;
+  int output_rate;
+  int32_t window_start = 0;
+  int32_t window_end = 0;
+  /* in output samples, which differ from the decoded ones only when resampling */
+  int32_t length;
+  int32_t position = 0;
+  bool endless = false;
+  std::optional<std::pair<int32_t, int32_t>> smpl_loop;
+  std::vector<sample_t> scratch;
+
+  std::unique_ptr<Resampler> resampler;
+  std::vector<float> resampled;
+  int32_t source_remaining = 0;
+  bool drained = false;
+
+  std::unique_ptr<FlacEncoder> flac;
+  std::unique_ptr<Analyzer> measure;
+
+  /* every output block passes through here once, native-endian and before any conversion */
+  template <typename T>
+  void analyze(const T *samples, const int32_t count) {
+    if (measure) {
+      measure->push(samples, count);
+    }
+  }
+
+  /* decodes blocks into the resampler until `samples` output samples are out, then converts them */
+  void render_resampled(uint8_t *dst, const int32_t samples, const size_t plane_stride) {
+    auto *vgmstream = vgmstream_ptr.get();
+    int32_t produced = 0;
+    while (produced < samples) {
+      auto pulled = resampler->pull(resampled.data() + static_cast<size_t>(produced) * channels, samples - produced);
+      produced += pulled;
+      if (produced >= samples) {
+        break;
+      }
+      if (endless || source_remaining > 0) {
+        auto to_decode = endless ? BlockSamples : std::min(source_remaining, BlockSamples);
+        render_vgmstream(scratch.data(), to_decode, vgmstream);
+        resampler->push(scratch.data(), to_decode);
+        source_remaining -= endless ? 0 : to_decode;
+      } else if (!drained) {
+        resampler->finish();
+        drained = true;
+      } else if (pulled == 0) {
+        // rounding left the output a sample longer than the padded input
+        std::fill(resampled.begin() + static_cast<std::ptrdiff_t>(produced) * channels, resampled.end(), 0.0F);
+        break;
+      }
+    }
+
+    analyze(resampled.data(), samples);
+    auto count = static_cast<size_t>(samples) * channels;
+    switch (format) {
+      case OutputFormat::Wav:
+      case OutputFormat::S16:
+        float_to_samples(resampled.data(), reinterpret_cast<sample_t *>(dst), count);
+#if SWAP_REQUIRED
+        swap_bytes(reinterpret_cast<sample_t *>(dst), count);
+#endif
+        break;
+      case OutputFormat::F32:
+        std::copy_n(resampled.data(), count, reinterpret_cast<float *>(dst));
+#if SWAP_REQUIRED
+        swap_bytes(reinterpret_cast<float *>(dst), count);
+#endif
+        break;
+      case OutputFormat::Planar:
+        deinterleave_float(resampled.data(), dst, plane_stride, channels, samples);
+        break;
+      case OutputFormat::Flac:
+        float_to_samples(resampled.data(), reinterpret_cast<sample_t *>(dst), count);
+        break;
+    }
+  }
+
+  [[nodiscard]]
+  auto to_output(const int32_t samples) const -> int32_t {
+    if (!resampler) {
+      return samples;
+    }
+    return static_cast<int32_t>(std::min<int64_t>(resampler->to_output(samples), INT32_MAX));
+  }
+
+  /* play config and mixing, neither of which can be undone on this decoder */
+  static void set_up(VGMSTREAM *vgmstream, const RenderOptions &options) {
+    if (options.configures_playback()) {
+      vgmstream_cfg_t config = {};
+      config.allow_play_forever = options.play_forever;
+      config.play_forever = options.play_forever;
+      config.ignore_loop = options.ignore_loop;
+      config.force_loop = options.force_loop;
+      config.ignore_fade = options.ignore_fade;
+      config.loop_count = options.loop_count.value_or(1.0);
+      config.fade_time = options.fade_time.value_or(0.0);
+      config.fade_delay = options.fade_delay.value_or(0.0);
+      vgmstream_apply_config(vgmstream, &config);
+    }
+
+    if (options.channel_mask != 0) {
+      mixing_macro_track(vgmstream, options.channel_mask);
+    }
+    if (options.layer_channels > 0) {
+      uint32_t mask = 0;
+      for (int channel = 0; channel < 32; ++channel) {
+        auto layer = channel / options.layer_channels;
+        if (options.layer_mask == 0 || (layer < 32 && (options.layer_mask >> layer) & 1)) {
+          mask |= 1U << channel;
+        }
+      }
+      mixing_macro_layer(vgmstream, options.layer_channels, mask, 'e');
+    }
+    if (options.downmix > 0) {
+      // vgmstream only downmixes by layout down to stereo, mono folds the pair
+      mixing_macro_downmix(vgmstream, 2);
+      int input = 0;
+      int output = 0;
+      vgmstream_mixing_enable(vgmstream, 0, &input, &output);
+      if (options.downmix == 1 && output >= 2) {
+        mixing_push_add(vgmstream, 0, 1, 1.0);
+        mixing_push_volume(vgmstream, 0, 0.5);
+        mixing_push_killmix(vgmstream, 1);
+      }
+    }
+  }
+
+  [[nodiscard]]
+  auto int16_output() const -> bool {
+    return format == OutputFormat::Wav || format == OutputFormat::S16 || format == OutputFormat::Flac;
+  }
+
+  [[nodiscard]]
+  auto decodes_in_place() const -> bool {
+    return int16_output() && !resampler;
+  }
+
+  [[nodiscard]]
+  auto to_sample(const std::optional<int32_t> &sample, const std::optional<double> &time, const int32_t fallback) const
+      -> int32_t {
+    if (sample) {
+      return *sample;
+    }
+    if (time) {
+      return static_cast<int32_t>(std::clamp<double>(std::round(*time * vgmstream_ptr->sample_rate), 0, INT32_MAX));
+    }
+    return fallback;
+  }
+};
+
+#endif  // SRC_RENDER_HPP_
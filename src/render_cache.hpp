@@ -0,0 +1,280 @@
+#ifndef SRC_RENDER_CACHE_HPP_
+#define SRC_RENDER_CACHE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./hash.hpp"
+
+/* finished renders kept for their next request: a memory-budgeted LRU, whose evictions can spill to files in a
+ * directory under a budget of their own; disabled until given a memory budget */
+class RenderCache {
+ public:
+  struct Entry {
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    int channels;
+    int32_t samples;
+  };
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t spills = 0;
+    uint64_t spill_hits = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t spilled_entries = 0;
+    size_t spilled_bytes = 0;
+  };
+
+  explicit RenderCache(const size_t max_bytes = 0, std::string directory = {}, const size_t max_spill_bytes = SIZE_MAX)
+      : max_bytes(max_bytes),
+        directory(std::move(directory)),
+        max_spill_bytes(max_spill_bytes),
+        spill_prefix(make_spill_prefix()) {}
+
+  RenderCache(const RenderCache &) = delete;
+  auto operator=(const RenderCache &) -> RenderCache & = delete;
+
+  ~RenderCache() {
+    for (auto &spilled : spill_order) {
+      remove(spill_path(spilled.first).c_str());
+    }
+  }
+
+  [[nodiscard]]
+  auto enabled() const -> bool {
+    return max_bytes > 0;
+  }
+
+  [[nodiscard]]
+  auto budget() const -> size_t {
+    return max_bytes;
+  }
+
+  [[nodiscard]]
+  auto spill_directory() const -> const std::string & {
+    return directory;
+  }
+
+  [[nodiscard]]
+  auto spill_budget() const -> size_t {
+    return max_spill_bytes;
+  }
+
+  auto find(const std::string &key) -> std::optional<Entry> {
+    {
+      std::lock_guard lock(mutex);
+      auto found = index.find(key);
+      if (found != index.end()) {
+        order.splice(order.begin(), order, found->second);
+        ++counters.hits;
+        return found->second->second;
+      }
+      if (spilled.find(key) == spilled.end()) {
+        ++counters.misses;
+        return std::nullopt;
+      }
+    }
+
+    // read outside of the lock, the file may be gone by then which only makes this a miss
+    auto entry = read_spilled(key);
+    std::lock_guard lock(mutex);
+    if (!entry) {
+      ++counters.misses;
+      return std::nullopt;
+    }
+    ++counters.spill_hits;
+    return entry;
+  }
+
+  /* renders bigger than the whole budget are not kept */
+  void insert(const std::string &key, Entry entry) {
+    auto size = entry.data->size();
+    std::vector<std::pair<std::string, Entry>> evicted;
+    {
+      std::lock_guard lock(mutex);
+      if (size > max_bytes || index.find(key) != index.end()) {
+        return;
+      }
+      order.emplace_front(key, std::move(entry));
+      index[key] = order.begin();
+      counters.bytes += size;
+
+      while (counters.bytes > max_bytes) {
+        auto &oldest = order.back();
+        counters.bytes -= oldest.second.data->size();
+        ++counters.evictions;
+        index.erase(oldest.first);
+        evicted.push_back(std::move(oldest));
+        order.pop_back();
+      }
+      counters.entries = order.size();
+    }
+
+    if (!directory.empty()) {
+      for (auto &[evicted_key, evicted_entry] : evicted) {
+        spill(evicted_key, evicted_entry);
+      }
+    }
+  }
+
+  [[nodiscard]]
+  auto stats() -> Stats {
+    std::lock_guard lock(mutex);
+    return counters;
+  }
+
+  /* process-wide cache shared by every bank */
+  static auto instance() -> std::shared_ptr<RenderCache> {
+    std::lock_guard lock(shared_mutex());
+    auto &cache = shared_cache();
+    if (!cache) {
+      cache = std::make_shared<RenderCache>();
+    }
+    return cache;
+  }
+
+  /* swaps in an empty cache, renders holding the old one still finish against it */
+  static void configure(const size_t max_bytes, const std::string &directory, const size_t max_spill_bytes) {
+    auto cache = std::make_shared<RenderCache>(max_bytes, directory, max_spill_bytes);
+    std::lock_guard lock(shared_mutex());
+    shared_cache().swap(cache);
+  }
+
+ private:
+  const size_t max_bytes;
+  const std::string directory;
+  const size_t max_spill_bytes;
+  /* tells this cache's files apart from those of the caches it replaced or runs next to, which delete theirs
+   * whenever they are destroyed */
+  const uint64_t spill_prefix;
+
+  std::mutex mutex;
+  std::list<std::pair<std::string, Entry>> order;
+  std::unordered_map<std::string, decltype(order)::iterator> index;
+  std::list<std::pair<std::string, size_t>> spill_order;
+  std::unordered_map<std::string, decltype(spill_order)::iterator> spilled;
+  Stats counters;
+
+  /* the file starts with the key, so a colliding file name reads as a miss */
+  [[nodiscard]]
+  auto spill_path(const std::string &key) const -> std::string {
+    char name[48];
+    snprintf(
+        name, sizeof(name), "/%016llx-%016llx.pcm", static_cast<unsigned long long>(spill_prefix),
+        static_cast<unsigned long long>(hash_string(key))
+    );
+    return directory + name;
+  }
+
+  /* random, and distinct within the process even if the random device is not */
+  static auto make_spill_prefix() -> uint64_t {
+    static std::atomic<uint64_t> created{0};
+    std::random_device random;
+    auto seed = (static_cast<uint64_t>(random()) << 32) ^ random();
+    return hash_bytes(reinterpret_cast<const uint8_t *>(&seed), sizeof(seed), created.fetch_add(1));
+  }
+
+  void spill(const std::string &key, const Entry &entry) {
+    auto size = entry.data->size();
+    if (size > max_spill_bytes) {
+      return;
+    }
+    auto path = spill_path(key);
+    auto *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      return;
+    }
+    auto key_length = static_cast<uint32_t>(key.size());
+    auto channels = static_cast<int32_t>(entry.channels);
+    auto written = fwrite(&key_length, sizeof(key_length), 1, file) == 1 &&
+                   fwrite(key.data(), 1, key.size(), file) == key.size() &&
+                   fwrite(&channels, sizeof(channels), 1, file) == 1 &&
+                   fwrite(&entry.samples, sizeof(entry.samples), 1, file) == 1 &&
+                   fwrite(entry.data->data(), 1, size, file) == size;
+    if (fclose(file) != 0 || !written) {
+      remove(path.c_str());
+      return;
+    }
+
+    std::vector<std::string> dropped;
+    {
+      std::lock_guard lock(mutex);
+      if (spilled.find(key) != spilled.end()) {
+        return;
+      }
+      spill_order.emplace_front(key, size);
+      spilled[key] = spill_order.begin();
+      counters.spilled_bytes += size;
+      ++counters.spills;
+
+      while (counters.spilled_bytes > max_spill_bytes) {
+        auto &oldest = spill_order.back();
+        counters.spilled_bytes -= oldest.second;
+        spilled.erase(oldest.first);
+        dropped.push_back(std::move(oldest.first));
+        spill_order.pop_back();
+      }
+      counters.spilled_entries = spill_order.size();
+    }
+    for (auto &dropped_key : dropped) {
+      remove(spill_path(dropped_key).c_str());
+    }
+  }
+
+  [[nodiscard]]
+  auto read_spilled(const std::string &key) const -> std::optional<Entry> {
+    auto *file = fopen(spill_path(key).c_str(), "rb");
+    if (file == nullptr) {
+      return std::nullopt;
+    }
+
+    std::optional<Entry> entry;
+    uint32_t key_length = 0;
+    int32_t channels = 0;
+    int32_t samples = 0;
+    std::string stored_key;
+    if (fread(&key_length, sizeof(key_length), 1, file) == 1 && key_length == key.size()) {
+      stored_key.resize(key_length);
+      if (fread(stored_key.data(), 1, key_length, file) == key_length && stored_key == key &&
+          fread(&channels, sizeof(channels), 1, file) == 1 && fread(&samples, sizeof(samples), 1, file) == 1) {
+        auto start = ftell(file);
+        fseek(file, 0, SEEK_END);
+        auto size = static_cast<size_t>(ftell(file) - start);
+        fseek(file, start, SEEK_SET);
+
+        auto data = std::make_shared<std::vector<uint8_t>>(size);
+        if (fread(data->data(), 1, size, file) == size) {
+          entry = Entry{std::move(data), channels, samples};
+        }
+      }
+    }
+    fclose(file);
+    return entry;
+  }
+
+  static auto shared_mutex() -> std::mutex & {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static auto shared_cache() -> std::shared_ptr<RenderCache> & {
+    static std::shared_ptr<RenderCache> cache;
+    return cache;
+  }
+};
+
+#endif  // SRC_RENDER_CACHE_HPP_
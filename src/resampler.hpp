@@ -0,0 +1,195 @@
+#ifndef SRC_RESAMPLER_HPP_
+#define SRC_RESAMPLER_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+extern "C" {
+#include "vgmstream/src/streamtypes.h"
+}
+
+/* windowed-sinc polyphase resampler from int16 blocks to interleaved -1.0 to 1.0 floats: the rate ratio is
+ * reduced to up/down integers so every output sample picks one precomputed phase of the filter, exact for
+ * the usual rates and quantized to MaxPhases phases for odd ones */
+class Resampler {
+ public:
+  enum class Quality {
+    Low,     /* 16 taps at unity ratio, for previews */
+    Medium,  /* 32 taps */
+    High     /* 64 taps, steeper and closer to Nyquist */
+  };
+
+  static constexpr int64_t MaxPhases = 1024;
+  static constexpr int MaxHalfTaps = 256;
+
+  Resampler(const int channels, const int input_rate, const int output_rate, const Quality quality)
+      : channels(channels), history(channels) {
+    auto divisor = std::gcd(input_rate, output_rate);
+    up = output_rate / divisor;
+    down = input_rate / divisor;
+    phases = std::min<int64_t>(up, MaxPhases);
+
+    auto [base_half, beta, rolloff] = parameters(quality);
+    /* downsampling lowers the cutoff below the input Nyquist, so the filter widens to keep its transition */
+    auto ratio = std::min(1.0, static_cast<double>(up) / down);
+    auto cutoff = ratio * rolloff;
+    half = std::min(MaxHalfTaps, static_cast<int>(std::ceil(base_half / ratio)));
+    half = (half + 3) / 4 * 4;
+    taps = half * 2;
+
+    coefficients.resize(static_cast<size_t>(phases) * taps);
+    for (int64_t phase = 0; phase < phases; ++phase) {
+      auto fraction = static_cast<double>(phase) / phases;
+      auto *row = &coefficients[phase * taps];
+      double sum = 0;
+      for (int i = 0; i < taps; ++i) {
+        auto distance = fraction + half - 1 - i;
+        auto value = cutoff * sinc(cutoff * distance) * kaiser(distance / half, beta);
+        row[i] = static_cast<float>(value);
+        sum += value;
+      }
+      // exact unity gain at DC for every phase, or the output ripples at the phase rate
+      for (int i = 0; i < taps; ++i) {
+        row[i] = static_cast<float>(row[i] / sum);
+      }
+    }
+
+    // the first output sample lines up with the first input sample
+    for (auto &plane : history) {
+      plane.assign(half - 1, 0.0F);
+    }
+  }
+
+  /* output samples per channel for `frames` input samples */
+  [[nodiscard]]
+  auto to_output(const int64_t frames) const -> int64_t {
+    return (frames * up + down - 1) / down;
+  }
+
+  /* appends `frames` interleaved input samples per channel */
+  void push(const sample_t *src, const int32_t frames) {
+    constexpr float scale = 1.0F / 32768.0F;
+    for (int channel = 0; channel < channels; ++channel) {
+      auto &plane = history[channel];
+      auto offset = plane.size();
+      plane.resize(offset + frames);
+      for (int32_t i = 0; i < frames; ++i) {
+        plane[offset + i] = static_cast<float>(src[i * channels + channel]) * scale;
+      }
+    }
+  }
+
+  /* pads the input with silence so the filter can drain past its last sample */
+  void finish() {
+    for (auto &plane : history) {
+      plane.resize(plane.size() + taps, 0.0F);
+    }
+  }
+
+  /* writes up to `max_frames` interleaved output samples per channel to dst, as many as the input pushed so
+   * far allows */
+  auto pull(float *dst, const int32_t max_frames) -> int32_t {
+    auto available = history[0].size();
+    int32_t produced = 0;
+    while (produced < max_frames && index + taps <= available) {
+      const auto *row = &coefficients[(phase * phases / up) * taps];
+      for (int channel = 0; channel < channels; ++channel) {
+        dst[produced * channels + channel] = dot(history[channel].data() + index, row);
+      }
+      ++produced;
+
+      phase += down;
+      index += static_cast<size_t>(phase / up);
+      phase %= up;
+    }
+
+    // drop what no later output can reach, in bulk to keep the moves rare
+    if (index >= CompactThreshold) {
+      for (auto &plane : history) {
+        plane.erase(plane.begin(), plane.begin() + static_cast<std::ptrdiff_t>(index));
+      }
+      index = 0;
+    }
+    return produced;
+  }
+
+ private:
+  static constexpr size_t CompactThreshold = 16384;
+  static constexpr double Pi = 3.14159265358979323846;
+
+  int channels;
+  int64_t up;
+  int64_t down;
+  int64_t phases;
+  int half;
+  int taps;
+  std::vector<float> coefficients;
+  std::vector<std::vector<float>> history;
+  size_t index = 0;
+  int64_t phase = 0;
+
+  struct Parameters {
+    int half;
+    double beta;
+    double rolloff;
+  };
+
+  static auto parameters(const Quality quality) -> Parameters {
+    switch (quality) {
+      case Quality::Low:
+        return {8, 6.0, 0.85};
+      case Quality::High:
+        return {32, 10.0, 0.96};
+      case Quality::Medium:
+      default:
+        return {16, 8.0, 0.92};
+    }
+  }
+
+  /* taps is a multiple of 8, eight partial sums let the compiler keep them in one vector register */
+  [[nodiscard]]
+  auto dot(const float *x, const float *row) const -> float {
+    float partial[8] = {};
+    for (int i = 0; i < taps; i += 8) {
+      for (int lane = 0; lane < 8; ++lane) {
+        partial[lane] += x[i + lane] * row[i + lane];
+      }
+    }
+    return ((partial[0] + partial[1]) + (partial[2] + partial[3])) +
+           ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+  }
+
+  static auto sinc(const double x) -> double {
+    if (std::abs(x) < 1e-9) {
+      return 1.0;
+    }
+    return std::sin(Pi * x) / (Pi * x);
+  }
+
+  static auto kaiser(const double x, const double beta) -> double {
+    if (std::abs(x) > 1.0) {
+      return 0.0;
+    }
+    return bessel_i0(beta * std::sqrt(1.0 - x * x)) / bessel_i0(beta);
+  }
+
+  static auto bessel_i0(const double x) -> double {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64; ++k) {
+      auto factor = x / (2.0 * k);
+      term *= factor * factor;
+      sum += term;
+      if (term < sum * 1e-12) {
+        break;
+      }
+    }
+    return sum;
+  }
+};
+
+#endif  // SRC_RESAMPLER_HPP_
@@ -0,0 +1,78 @@
+#ifndef SRC_SEEK_HPP_
+#define SRC_SEEK_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "vgmstream/src/vgmstream.h"
+}
+
+/* bytes per sample of the codecs that keep no decoder state between samples, 0 for every other codec */
+inline auto stateless_sample_size(const coding_t coding) -> size_t {
+  switch (coding) {
+    case coding_PCM8:
+    case coding_PCM8_U:
+      return 1;
+    case coding_PCM16LE:
+    case coding_PCM16BE:
+      return 2;
+    case coding_PCMFLOAT:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+/* whether seek_exact() can land on any sample before `end`: stateless codecs laid out flat or in plain
+ * interleave, played without a config (fades follow the play position) and not looping inside the window */
+inline auto seeks_exactly(const VGMSTREAM *vgmstream, const int32_t end) -> bool {
+  auto sample_size = stateless_sample_size(vgmstream->coding_type);
+  if (sample_size == 0 || vgmstream->config_enabled) {
+    return false;
+  }
+  if (vgmstream->loop_flag && end > vgmstream->loop_end_sample) {
+    return false;
+  }
+  switch (vgmstream->layout_type) {
+    case layout_none:
+      return true;
+    case layout_interleave:
+      return vgmstream->interleave_block_size > 0 && vgmstream->interleave_block_size % sample_size == 0 &&
+             vgmstream->interleave_first_block_size == 0;
+    default:
+      return false;
+  }
+}
+
+/* positions a freshly reset decoder at `sample` by setting its offsets directly, where seek_vgmstream would
+ * decode every sample before it; false and the decoder untouched when seeks_exactly() does not hold or the
+ * sample falls in a short last interleave block */
+inline auto seek_exact(VGMSTREAM *vgmstream, const int32_t sample, const int32_t end) -> bool {
+  if (!seeks_exactly(vgmstream, end) || vgmstream->current_sample != 0) {
+    return false;
+  }
+
+  if (vgmstream->layout_type == layout_none) {
+    // flat decoders read each channel at offset + sample, the offsets never move
+    vgmstream->current_sample = sample;
+    vgmstream->samples_into_block = sample;
+    return true;
+  }
+
+  auto sample_size = stateless_sample_size(vgmstream->coding_type);
+  auto block_samples = static_cast<int32_t>(vgmstream->interleave_block_size / sample_size);
+  auto block = sample / block_samples;
+  if (vgmstream->interleave_last_block_size > 0 && block >= vgmstream->num_samples / block_samples) {
+    return false;
+  }
+  auto block_offset = static_cast<offv_t>(block) * vgmstream->interleave_block_size * vgmstream->channels;
+  for (int channel = 0; channel < vgmstream->channels; ++channel) {
+    vgmstream->ch[channel].offset = vgmstream->ch[channel].channel_start_offset + block_offset;
+  }
+  vgmstream->current_sample = sample;
+  vgmstream->samples_into_block = sample % block_samples;
+  return true;
+}
+
+#endif  // SRC_SEEK_HPP_
@@ -0,0 +1,50 @@
+#ifndef SRC_STATS_HPP_
+#define SRC_STATS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/* where one render spent its time and memory, only collected when asked for */
+struct RenderStats {
+  using Clock = std::chrono::steady_clock;
+
+  double queue_ms = 0;
+  double open_ms = 0;
+  /* held back by the memory budget */
+  double memory_wait_ms = 0;
+  double decode_ms = 0;
+  int64_t samples = 0;
+  size_t bytes = 0;
+  size_t allocated = 0;
+  size_t resizes = 0;
+  bool cache_hit = false;
+
+  // when the result was handed to the JS thread, to tell how long the delivery took
+  Clock::time_point finished;
+
+  static auto elapsed_ms(const Clock::time_point since) -> double {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+  }
+};
+
+/* process-wide totals, relaxed atomics so they can stay on */
+class RenderCounters {
+ public:
+  std::atomic<uint64_t> renders{0};
+  std::atomic<uint64_t> samples_decoded{0};
+  std::atomic<uint64_t> bytes_allocated{0};
+  std::atomic<uint64_t> resizes{0};
+
+  static void add(std::atomic<uint64_t> &counter, const uint64_t value) {
+    counter.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  static auto instance() -> RenderCounters & {
+    static RenderCounters counters;
+    return counters;
+  }
+};
+
+#endif  // SRC_STATS_HPP_
@@ -0,0 +1,135 @@
+#ifndef SRC_STREAMFILE_HPP_
+#define SRC_STREAMFILE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "./companions.hpp"
+
+extern "C" {
+#include "vgmstream/src/streamfile.h"
+#include "vgmstream/src/vgmstream.h"
+}
+
+/* read-only STREAMFILE over memory owned by someone else (a Node buffer, a mapping...) */
+class MemoryStreamFile {
+ public:
+  explicit MemoryStreamFile(
+      const uint8_t *buffer,
+      const size_t length,
+      const int stream_index,
+      std::string filename,
+      std::shared_ptr<Companions> companions = nullptr,
+      const bool owned = false
+  )
+      : vt(new_inner_streamfile(stream_index)),
+        filename(std::move(filename)),
+        buffer(buffer),
+        length(length),
+        companions(std::move(companions)),
+        owned(owned) {}
+
+  // must stay the first member, vgmstream only ever sees &vt
+  STREAMFILE vt;
+  std::string filename;
+  uint8_t const *buffer;
+  size_t length;
+  offv_t offset = 0;
+  std::shared_ptr<Companions> companions;
+  // opened by vgmstream itself, which closes (and so deletes) it
+  bool owned;
+
+ private:
+  static auto read(MemoryStreamFile *stream_file, uint8_t *dst, offv_t offset, size_t length) -> size_t {
+    if (offset < 0 || static_cast<size_t>(offset) >= stream_file->length) {
+      return 0;
+    }
+    auto available = std::min(length, stream_file->length - static_cast<size_t>(offset));
+    memcpy(dst, stream_file->buffer + offset, available);
+    // NOLINTNEXTLINE bugprone-narrowing-conversions
+    stream_file->offset = offset + available;
+    return available;
+  }
+
+  /* get max offset */
+  static auto get_size(MemoryStreamFile *stream_file) -> size_t { return stream_file->length; }
+
+  // todo: DO NOT USE, NOT RESET PROPERLY (remove?)
+  static auto get_offset(MemoryStreamFile *stream_file) -> offv_t { return stream_file->offset; }
+
+  /* copy current filename to name buf */
+  static void get_name(MemoryStreamFile *stream_file, char *name, size_t name_size) {
+    auto size = std::min(stream_file->filename.size() + 1, name_size);
+    memcpy(name, stream_file->filename.c_str(), size);
+    name[size - 1] = '\0';
+  }
+
+  /* open another streamfile from filename */
+  static auto open(MemoryStreamFile *stream_file, const char *const filename, size_t buf_size) -> STREAMFILE * {
+    std::optional<MemoryView> view;
+    if (strcmp(filename, stream_file->filename.c_str()) == 0) {
+      if (!stream_file->owned) {
+        return &stream_file->vt;
+      }
+      view = MemoryView{stream_file->buffer, stream_file->length};
+    } else if (stream_file->companions) {
+      view = stream_file->companions->resolve(filename);
+    }
+    if (!view) {
+      return nullptr;
+    }
+
+    auto *companion = new MemoryStreamFile(
+        view->data, view->length, stream_file->vt.stream_index, filename, stream_file->companions, true
+    );
+    return &companion->vt;
+  }
+
+  /* free current STREAMFILE */
+  static void close(MemoryStreamFile *stream_file) {
+    // the one handed to init_vgmstream_from_STREAMFILE lives as long as its VGMSTREAM
+    if (stream_file->owned) {
+      delete stream_file;
+    }
+  }
+
+  static auto new_inner_streamfile(const int stream_index) -> STREAMFILE {
+    return STREAMFILE{
+        .read = reinterpret_cast<size_t (*)(struct _STREAMFILE *, uint8_t *, offv_t, size_t)>(read),
+        .get_size = reinterpret_cast<size_t (*)(struct _STREAMFILE *)>(get_size),
+        .get_offset = reinterpret_cast<offv_t (*)(struct _STREAMFILE *)>(get_offset),
+        .get_name = reinterpret_cast<void (*)(struct _STREAMFILE *, char *, size_t)>(get_name),
+        .open = reinterpret_cast<struct _STREAMFILE *(*)(struct _STREAMFILE *, const char *const, size_t)>(open),
+        .close = reinterpret_cast<void (*)(struct _STREAMFILE *)>(close),
+        .stream_index = stream_index,
+    };
+  }
+};
+
+/* parses `stream_index` out of the buffer, returns nullptr when vgmstream cannot open it */
+inline auto vgmstream_from_memory(
+    const uint8_t *buffer,
+    const size_t length,
+    const int stream_index,
+    const std::string &filename,
+    const std::shared_ptr<Companions> &companions = nullptr
+) -> std::shared_ptr<VGMSTREAM> {
+  auto *buffer_stream_file = new MemoryStreamFile(buffer, length, stream_index, filename, companions);
+  auto *vgmstream = init_vgmstream_from_STREAMFILE(reinterpret_cast<STREAMFILE *>(buffer_stream_file));
+  if (vgmstream == nullptr) {
+    delete buffer_stream_file;
+    return nullptr;
+  }
+  return std::shared_ptr<VGMSTREAM>(vgmstream, [=](auto ptr) {
+    close_vgmstream(ptr);
+    delete buffer_stream_file;
+  });
+}
+
+#endif  // SRC_STREAMFILE_HPP_
@@ -11,38 +11,32 @@
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
 #include <string>
-#include <thread>
-#include <tuple>
 #include <type_traits>
 #include <utility>
 
-extern "C" {
-#include "vgmstream/src/streamfile.h"
-#include "vgmstream/src/vgmstream.h"
-}
-
-#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
-#define SWAP_REQUIRED true
-#else
-#define SWAP_REQUIRED false
-#endif
+#include "./endian.hpp"
+#include "./worker_pool.hpp"
 
 using NapiBuffer = Napi::Buffer<uint8_t>;
 
+/* output buffer handed to Node without copying; sized exactly when the caller knows the final length,
+ * otherwise it grows by half its capacity through realloc, which can often extend in place */
 class ExtendableBuffer {
  public:
   explicit ExtendableBuffer(const size_t initial_size = 1024) : initial_size(initial_size) { initialize(); }
   ~ExtendableBuffer() {
     if (initialized) {
-      delete[] ptr;
+      free(ptr);
     }
   }
 
   void initialize() {
     initialized = true;
-    ptr = new uint8_t[initial_size];
+    ptr = static_cast<uint8_t *>(malloc(std::max<size_t>(initial_size, 1)));
     capacity = initial_size;
     current = 0;
   }
@@ -53,7 +47,7 @@ class ExtendableBuffer {
       return;
     }
     if (current + length * sizeof(T) > capacity) {
-      resize(std::max(capacity * 2, current + length * sizeof(T)));
+      resize(std::max(capacity + capacity / 2, current + length * sizeof(T)));
     }
   }
 
@@ -62,7 +56,7 @@ class ExtendableBuffer {
     if (!initialized) {
       return;
     }
-    ensure<T>(length * sizeof(T));
+    ensure<T>(length);
     memcpy(ptr + current, buffer, length * sizeof(T));
     swap<T>(length);
     current += length * sizeof(T);
@@ -82,29 +76,54 @@ class ExtendableBuffer {
     if (!initialized) {
       return;
     }
-    auto *new_ptr = new uint8_t[new_size];
-    memcpy(new_ptr, ptr, current);
-    delete[] ptr;
+    auto *new_ptr = static_cast<uint8_t *>(realloc(ptr, std::max<size_t>(new_size, 1)));
+    if (new_ptr == nullptr) {
+      throw std::bad_alloc();
+    }
     ptr = new_ptr;
     capacity = new_size;
+    ++resizes;
   }
 
   auto move_to_node_buffer(const Napi::Env &env) {
     if (!initialized) {
-      auto *empty_buf = new uint8_t[1];
-      return Napi::Buffer<uint8_t>::New(env, empty_buf, 0, [](auto env, auto buf) { delete[] buf; });
+      auto *empty_buf = static_cast<uint8_t *>(malloc(1));
+      return Napi::Buffer<uint8_t>::New(env, empty_buf, 0, [](auto env, auto buf) { free(buf); });
     }
     initialized = false;
-    auto buf = Napi::Buffer<uint8_t>::New(env, ptr, current, [](auto env, auto buf) { delete[] buf; });
+    auto buf = Napi::Buffer<uint8_t>::New(env, ptr, current, [](auto env, auto buf) { free(buf); });
     return buf;
   }
 
+  [[nodiscard]]
+  auto data() const -> const uint8_t * {
+    return ptr;
+  }
+
+  [[nodiscard]]
+  auto size() const -> size_t {
+    return current;
+  }
+
+  /* bytes reserved, which can be more than size() */
+  [[nodiscard]]
+  auto allocated() const -> size_t {
+    return capacity;
+  }
+
+  /* times the buffer had to grow past its initial size */
+  [[nodiscard]]
+  auto resize_count() const -> size_t {
+    return resizes;
+  }
+
  private:
   uint8_t *ptr;
   const size_t initial_size;
   bool initialized = false;
   size_t capacity;
   size_t current;
+  size_t resizes = 0;
 
   template <typename T>
   void swap(const size_t count) {
@@ -112,15 +131,100 @@ class ExtendableBuffer {
     if (sizeof(T) == 1) {
       return;
     }
-    for (auto *i = ptr + current; i < ptr + current + count * sizeof(T); i += sizeof(T)) {
-      for (auto *left_ptr = i, *right_ptr = i + sizeof(T) - 1; left_ptr < right_ptr; ++left_ptr, --right_ptr) {
-        std::swap(*left_ptr, *right_ptr);
-      }
-    }
+    swap_bytes(reinterpret_cast<T *>(ptr + current), count);
 #endif
   }
 };
 
+/* funnels completions from pool threads back onto the JS thread of one environment through a thread-safe
+ * function; jobs hold it shared, so one finishing after its environment is gone finds it closed */
+class Dispatcher {
+ public:
+  using Callback = std::function<void(Napi::Env)>;
+
+ private:
+  static void call_js(Napi::Env env, Napi::Function callback, Dispatcher *context, Callback *data) {
+    if (env != nullptr) {
+      (*data)(env);
+      context->release(env);
+    }
+    delete data;
+  }
+
+  using ThreadSafeFunction = Napi::TypedThreadSafeFunction<Dispatcher, Callback, Dispatcher::call_js>;
+
+ public:
+  explicit Dispatcher(Napi::Env env) : func(ThreadSafeFunction::New(env, "node-vgmstream", 0, 1, this)) {
+    // only keep the event loop alive while something is in flight
+    this->func.Unref(env);
+  }
+
+  /* called on the JS thread before handing work to the pool */
+  void retain(Napi::Env env) {
+    if (pending++ == 0) {
+      this->func.Ref(env);
+    }
+  }
+
+  /* called on the JS thread when a retained job ends without dispatching */
+  void release(Napi::Env env) {
+    if (--pending == 0) {
+      this->func.Unref(env);
+    }
+  }
+
+  /* may be called from any thread, runs `callback` on the JS thread unless the environment is shutting down */
+  void dispatch(Callback &&callback) {
+    std::lock_guard lock(mutex);
+    if (closed) {
+      return;
+    }
+    auto *data = new Callback(std::move(callback));
+    if (this->func.BlockingCall(data) != napi_ok) {
+      delete data;
+    }
+  }
+
+  /* called from the environment's cleanup hook, before the thread-safe function is torn down */
+  void close() {
+    std::lock_guard lock(mutex);
+    closed = true;
+  }
+
+  static auto instance(Napi::Env env) -> std::shared_ptr<Dispatcher>;
+
+ private:
+  ThreadSafeFunction func;
+  size_t pending = 0;
+  std::mutex mutex;
+  bool closed = false;
+};
+
+/* what one JS environment (the main thread or a worker_threads worker) owns of the addon; the worker pool,
+ * the render cache and the counters stay process-wide and are shared by every environment */
+struct AddonData {
+  Napi::FunctionReference vgmstream;
+  Napi::FunctionReference sub_song;
+  Napi::FunctionReference reader;
+  std::shared_ptr<Dispatcher> dispatcher;
+
+  static auto of(Napi::Env env) -> AddonData & { return *env.GetInstanceData<AddonData>(); }
+
+  /* attaches a new AddonData to `env`, freed along with it */
+  static auto attach(Napi::Env env) -> AddonData & {
+    auto *data = new AddonData();
+    data->dispatcher = std::make_shared<Dispatcher>(env);
+    env.SetInstanceData(data);
+    // hooks run in reverse order, so this one runs before the thread-safe function's own
+    env.AddCleanupHook([dispatcher = data->dispatcher] { dispatcher->close(); });
+    return *data;
+  }
+};
+
+inline auto Dispatcher::instance(Napi::Env env) -> std::shared_ptr<Dispatcher> {
+  return AddonData::of(env).dispatcher;
+}
+
 template <typename T>
 class Promise {
  public:
@@ -129,66 +233,106 @@ class Promise {
   using PromiseFunc = std::function<void(ResolveFunc, RejectFunc)>;
   using TransformFunc = std::function<Napi::Value(Napi::Env env, T *value)>;
 
- private:
-  using Data = std::tuple<bool, T *, const char *>;
-  using FinalizerDataType = void;
-
-  static void call_js(Napi::Env env, Napi::Function callback, Promise *context, Data *data) {
-    auto [is_success, value, error_message] = *data;
-    context->thread.join();
-    if (is_success) {
-      context->deferred.Resolve(context->transform(env, value));
-    } else {
-      context->deferred.Reject(Napi::String::From(env, error_message));
+  explicit Promise(Napi::Env env, TransformFunc &&transform)
+      : deferred(Napi::Promise::Deferred::New(env)), transform(std::move(transform)) {}
+
+  /* runs `process` on the shared worker pool and settles the returned promise on the JS thread; `process` may
+   * also hand `resolve` or `reject` on to be called later, from any thread */
+  static auto start(Napi::Env env, PromiseFunc &&process, TransformFunc &&transform, const int priority = 0)
+      -> Napi::Promise {
+    auto promise = std::make_shared<Promise>(env, std::move(transform));
+    auto dispatcher = Dispatcher::instance(env);
+
+    dispatcher->retain(env);
+    auto submitted = WorkerPool::instance()->submit(
+        [promise, dispatcher, process = std::move(process)]() mutable {
+          auto outcome = std::make_shared<Outcome>(promise, dispatcher);
+          try {
+            process(
+                [outcome](auto value) { outcome->settle(value, {}); },
+                [outcome](auto message) { outcome->settle(nullptr, message); }
+            );
+          } catch (const std::exception &error) {
+            outcome->settle(nullptr, error.what());
+          }
+          // drop whatever the job captured before handing over to the JS thread
+          process = nullptr;
+          outcome->release();
+        },
+        priority
+    );
+
+    if (!submitted) {
+      dispatcher->release(env);
+      promise->settle(env, nullptr, "render queue is full");
     }
-    delete value;
-    delete data;
+    return promise->deferred.Promise();
   }
 
-  using ThreadSafeFunction = Napi::TypedThreadSafeFunction<Promise, Data, Promise::call_js>;
+ private:
+  /* where `resolve` and `reject` lead: the first call settles the promise and later ones are ignored; held back
+   * until the job is done with its captures, and rejected when every copy is dropped without a call */
+  class Outcome {
+   public:
+    Outcome(std::shared_ptr<Promise> promise, std::shared_ptr<Dispatcher> dispatcher)
+        : promise(std::move(promise)), dispatcher(std::move(dispatcher)) {}
+
+    Outcome(const Outcome &) = delete;
+    auto operator=(const Outcome &) -> Outcome & = delete;
+
+    ~Outcome() { settle(nullptr, "Native error: Promise should either resolved or rejected."); }
+
+    void settle(T *value, const std::string &message) {
+      std::unique_lock lock(mutex);
+      if (settled) {
+        delete value;
+        return;
+      }
+      settled = true;
+      resolved_value.reset(value);
+      error_message = message;
+      if (!held) {
+        lock.unlock();
+        dispatch();
+      }
+    }
 
- public:
-  explicit Promise(Napi::Env env, PromiseFunc &&process, TransformFunc &&transform)
-      : deferred(Napi::Promise::Deferred::New(env)), transform(std::move(transform)) {
-    this->func =
-        ThreadSafeFunction::New(env, "Resource Name", 0, 1, this, [](Napi::Env, FinalizerDataType *, Promise *context) {
-          delete context;
-        });
-    this->thread = std::thread([process = std::move(process), this] {
-      bool resolved = false;
-      bool rejected = false;
-      T *resolved_value = nullptr;
-      const char *error_message = nullptr;
-      process(
-          [&](auto value) {
-            resolved = true;
-            resolved_value = value;
-          },
-          [&](auto message) {
-            rejected = true;
-            error_message = message;
-          }
-      );
-      if (resolved) {
-        this->func.BlockingCall(new Data(true, resolved_value, nullptr));
-      } else if (rejected) {
-        this->func.BlockingCall(new Data(false, nullptr, error_message));
-      } else {
-        throw std::logic_error("Native error: Promise should either resolved or rejected.");
+    /* called once the job returned */
+    void release() {
+      std::unique_lock lock(mutex);
+      held = false;
+      if (settled) {
+        lock.unlock();
+        dispatch();
       }
-      this->func.Release();
-    });
-  }
+    }
 
-  [[nodiscard]]
-  auto promise() const -> Napi::Promise {
-    return this->deferred.Promise();
+   private:
+    std::shared_ptr<Promise> promise;
+    std::shared_ptr<Dispatcher> dispatcher;
+
+    std::mutex mutex;
+    bool held = true;
+    bool settled = false;
+    std::shared_ptr<T> resolved_value;
+    std::string error_message;
+
+    void dispatch() {
+      dispatcher->dispatch([promise = promise, resolved_value = resolved_value, error_message = error_message](
+                               Napi::Env env
+                           ) { promise->settle(env, resolved_value.get(), error_message); });
+    }
+  };
+
+  void settle(Napi::Env env, T *value, const std::string &error_message) {
+    if (value != nullptr) {
+      this->deferred.Resolve(this->transform(env, value));
+    } else {
+      this->deferred.Reject(Napi::Error::New(env, error_message).Value());
+    }
   }
 
- private:
   Napi::Promise::Deferred deferred;
-  std::thread thread;
-  ThreadSafeFunction func;
   TransformFunc transform;
 };
 
@@ -254,29 +398,63 @@ class Helper {
     return arr;
   }
 
+  [[nodiscard]]
+  auto resolved(const Napi::Value &value) const {
+    auto deferred = Napi::Promise::Deferred::New(this->env);
+    deferred.Resolve(value);
+    return deferred.Promise();
+  }
+
   template <typename T>
   [[nodiscard]]
-  auto async(typename Promise<T>::PromiseFunc &&process, typename Promise<T>::TransformFunc &&transform) const {
-    auto promise = new Promise<T>(this->env, std::move(process), std::move(transform));
-    return promise->promise();
+  auto async(
+      typename Promise<T>::PromiseFunc &&process,
+      typename Promise<T>::TransformFunc &&transform,
+      const int priority = 0
+  ) const {
+    return Promise<T>::start(this->env, std::move(process), std::move(transform), priority);
   }
 };
 
+template <typename T>
+auto is_arg_type(const Napi::Value &arg) -> bool {
+  if (std::is_same_v<T, Napi::Number>) {
+    return arg.IsNumber();
+  }
+  if (std::is_same_v<T, Napi::String>) {
+    return arg.IsString();
+  }
+  if (std::is_same_v<T, Napi::Boolean>) {
+    return arg.IsBoolean();
+  }
+  if (std::is_same_v<T, NapiBuffer>) {
+    return arg.IsBuffer();
+  }
+  if (std::is_same_v<T, Napi::Array>) {
+    return arg.IsArray();
+  }
+  if (std::is_same_v<T, Napi::Object>) {
+    return arg.IsObject();
+  }
+  return false;
+}
+
+template <typename T>
+constexpr auto arg_type_name() -> const char * {
+  return std::is_same_v<T, Napi::Number>    ? "number"
+       : std::is_same_v<T, Napi::String>  ? "string"
+       : std::is_same_v<T, Napi::Boolean> ? "boolean"
+       : std::is_same_v<T, NapiBuffer>    ? "buffer"
+       : std::is_same_v<T, Napi::Array>   ? "array"
+       : std::is_same_v<T, Napi::Object>  ? "object"
+                                          : "unknown";
+}
+
 template <typename T>
 auto obtain_arg(const Napi::CallbackInfo &info, const size_t index) -> T {
   auto arg = info[index];
-  auto is_correct = false;
-  if (std::is_same_v<T, Napi::Number>) {
-    is_correct = arg.IsNumber();
-  } else if (std::is_same_v<T, Napi::String>) {
-    is_correct = arg.IsString();
-  } else if (std::is_same_v<T, NapiBuffer>) {
-    is_correct = arg.IsBuffer();
-  }
-  constexpr auto typestr = std::is_same_v<T, Napi::Number> ? "number"
-                         : std::is_same_v<T, Napi::String> ? "string"
-                         : std::is_same_v<T, NapiBuffer>   ? "buffer"
-                                                           : "unknown";
+  auto is_correct = is_arg_type<T>(arg);
+  constexpr auto typestr = arg_type_name<T>();
   if (!is_correct) {
     auto length = snprintf(nullptr, 0, "expect arg[%lu] to be a %s but mismatched", index, typestr);
     auto *buf = new char[length + 1];
@@ -289,79 +467,29 @@ auto obtain_arg(const Napi::CallbackInfo &info, const size_t index) -> T {
 
 template <typename T>
 auto obtain_arg(const Napi::CallbackInfo &info, const size_t index, const T &default_value) -> T {
-  return index < info.Length() ? obtain_arg<T>(info, index) : default_value;
+  return index < info.Length() && !info[index].IsUndefined() ? obtain_arg<T>(info, index) : default_value;
 }
 
-auto new_inner_streamfile(int stream_index) -> STREAMFILE;
-
-class NodeBufferStreamFile {
- public:
-  explicit NodeBufferStreamFile(const NapiBuffer &buffer, const int stream_index, std::string filename)
-      : buffer(buffer.Data()),
-        length(buffer.Length()),
-        vt(new_inner_streamfile(stream_index)),
-        filename(std::move(filename)) {}
-  ~NodeBufferStreamFile() {}
-
-  STREAMFILE vt;
-  std::string filename;
-  uint8_t const *buffer;
-  size_t length;
-  offv_t offset;
-};
-
-/* get max offset */
-auto read(NodeBufferStreamFile *stream_file, uint8_t *dst, offv_t offset, size_t length) -> size_t {
-  memcpy(dst, stream_file->buffer + offset, std::min(length, stream_file->length - offset));
-  // NOLINTNEXTLINE bugprone-narrowing-conversions
-  stream_file->offset = offset + length;
-  return length;
-}
-
-/* get max offset */
-auto get_size(NodeBufferStreamFile *stream_file) -> size_t { return stream_file->length; }
-
-// todo: DO NOT USE, NOT RESET PROPERLY (remove?)
-auto get_offset(NodeBufferStreamFile *stream_file) -> offv_t { return stream_file->offset; }
-
-/* copy current filename to name buf */
-void get_name(NodeBufferStreamFile *stream_file, char *name, size_t name_size) {
-  auto size = std::min(stream_file->filename.size() + 1, name_size);
-  memcpy(name, stream_file->filename.c_str(), size);
-  name[size - 1] = '\0';
-}
-/* open another streamfile from filename */
-auto open(NodeBufferStreamFile *stream_file, const char *const filename, size_t buf_size) -> STREAMFILE * {
-  if (strcmp(filename, stream_file->filename.c_str()) == 0) {
-    return &stream_file->vt;
+template <typename T>
+auto obtain_option(const Napi::Object &options, const char *key, const T &default_value) -> T {
+  auto option = options.Get(key);
+  if (option.IsUndefined()) {
+    return default_value;
   }
-  return nullptr;
-}
-
-/* free current STREAMFILE */
-void close(NodeBufferStreamFile *stream_file) {
-  // do nothing
-}
-
-auto new_inner_streamfile(const int stream_index) -> STREAMFILE {
-  return STREAMFILE{
-      .read = reinterpret_cast<size_t (*)(struct _STREAMFILE *, uint8_t *, offv_t, size_t)>(read),
-      .get_size = reinterpret_cast<size_t (*)(struct _STREAMFILE *)>(get_size),
-      .get_offset = reinterpret_cast<offv_t (*)(struct _STREAMFILE *)>(get_offset),
-      .get_name = reinterpret_cast<void (*)(struct _STREAMFILE *, char *, size_t)>(get_name),
-      .open = reinterpret_cast<struct _STREAMFILE *(*)(struct _STREAMFILE *, const char *const, size_t)>(open),
-      .close = reinterpret_cast<void (*)(struct _STREAMFILE *)>(close),
-      .stream_index = stream_index,
-  };
+  if (!is_arg_type<T>(option)) {
+    auto message = std::string("expect option \"") + key + "\" to be a " + arg_type_name<T>() + " but not";
+    Napi::TypeError::New(options.Env(), message).ThrowAsJavaScriptException();
+    return default_value;
+  }
+  return option.As<T>();
 }
 
-auto vgmstream_from_buffer(const NapiBuffer &buffer, const int stream_index, const std::string &filename) {
-  auto *buffer_stream_file = new NodeBufferStreamFile(buffer, stream_index, filename);
-  auto *vgmstream = init_vgmstream_from_STREAMFILE(reinterpret_cast<STREAMFILE *>(buffer_stream_file));
-  return std::shared_ptr<VGMSTREAM>(vgmstream, [=](auto ptr) {
-    close_vgmstream(ptr);
-    delete buffer_stream_file;
-  });
+template <typename T>
+auto obtain_option(const Napi::Object &options, const char *key) -> std::optional<T> {
+  if (options.Get(key).IsUndefined()) {
+    return std::nullopt;
+  }
+  return obtain_option<T>(options, key, T());
 }
 
 #endif  // SRC_UTILS_HPP_
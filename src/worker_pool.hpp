@@ -0,0 +1,227 @@
+#ifndef SRC_WORKER_POOL_HPP_
+#define SRC_WORKER_POOL_HPP_
+
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* fixed-size pool of native threads with a bounded, prioritised job queue */
+class WorkerPool {
+ public:
+  using Job = std::function<void()>;
+
+  static constexpr size_t DefaultMaxQueue = 4096;
+
+  static auto default_threads() -> size_t { return std::max<size_t>(1, std::thread::hardware_concurrency()); }
+
+  explicit WorkerPool(const size_t threads = default_threads(), const size_t max_queue = DefaultMaxQueue)
+      : state(std::make_shared<State>()), threads(std::max<size_t>(1, threads)) {
+    state->max_queue = max_queue;
+    for (size_t i = 0; i < this->threads; ++i) {
+      std::thread([state = state] { WorkerPool::work(*state); }).detach();
+    }
+  }
+
+  /* queued jobs still run, the threads leave once the queue is drained */
+  ~WorkerPool() {
+    {
+      std::lock_guard lock(state->mutex);
+      state->stopping = true;
+    }
+    state->condition.notify_all();
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  auto operator=(const WorkerPool &) -> WorkerPool & = delete;
+
+  /* higher priority runs first, equal priorities run in submission order;
+   * returns false without taking the job when the queue is full */
+  auto submit(Job &&job, const int priority = 0) -> bool {
+    {
+      std::lock_guard lock(state->mutex);
+      if (state->max_queue > 0 && state->queue.size() >= state->max_queue) {
+        return false;
+      }
+      state->queue.push_back(Entry{priority, state->sequence++, std::move(job)});
+      std::push_heap(state->queue.begin(), state->queue.end(), Entry::later);
+    }
+    state->condition.notify_one();
+    return true;
+  }
+
+  /* runs `task` for every index below `count`, at once where pool threads are idle: all but the first are
+   * offered to the pool, and the calling thread (which may be a pool thread itself) runs the first and then
+   * whatever nobody picked up. It never waits on a task that has not started, so it cannot deadlock and adds
+   * no threads; the first exception a task throws is rethrown once none is running, and skips those not
+   * started yet */
+  void run_all(const size_t count, const std::function<void(size_t)> &task) {
+    auto fork = std::make_shared<Fork>();
+    fork->claimed.assign(count, false);
+    fork->task = &task;
+    for (size_t index = 1; index < count; ++index) {
+      try {
+        if (!submit([fork, index] { fork->run(index); }, ForkPriority)) {
+          break;
+        }
+      } catch (const std::exception &) {
+        break;
+      }
+    }
+    for (size_t index = 0; index < count; ++index) {
+      fork->run(index);
+    }
+
+    std::unique_lock lock(fork->mutex);
+    fork->condition.wait(lock, [&] { return fork->running == 0; });
+    fork->task = nullptr;
+    if (fork->error) {
+      std::rethrow_exception(fork->error);
+    }
+  }
+
+  [[nodiscard]]
+  auto size() const -> size_t {
+    return threads;
+  }
+
+  [[nodiscard]]
+  auto max_queue() const -> size_t {
+    return state->max_queue;
+  }
+
+  [[nodiscard]]
+  auto queued() const -> size_t {
+    std::lock_guard lock(state->mutex);
+    return state->queue.size();
+  }
+
+  [[nodiscard]]
+  auto active() const -> size_t {
+    std::lock_guard lock(state->mutex);
+    return state->active;
+  }
+
+  /* process-wide pool shared by every render */
+  static auto instance() -> std::shared_ptr<WorkerPool> {
+    std::lock_guard lock(shared_mutex());
+    auto &pool = shared_pool();
+    if (!pool) {
+      pool = std::make_shared<WorkerPool>();
+    }
+    return pool;
+  }
+
+  /* swaps in a new pool, jobs already queued on the old one still complete */
+  static void configure(const size_t threads, const size_t max_queue) {
+    auto pool = std::make_shared<WorkerPool>(threads, max_queue);
+    std::lock_guard lock(shared_mutex());
+    shared_pool().swap(pool);
+  }
+
+ private:
+  struct Entry {
+    int priority;
+    uint64_t sequence;
+    Job job;
+
+    static auto later(const Entry &left, const Entry &right) -> bool {
+      return left.priority != right.priority ? left.priority < right.priority : left.sequence > right.sequence;
+    }
+  };
+
+  struct State {
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<Entry> queue;
+    size_t max_queue = 0;
+    size_t active = 0;
+    uint64_t sequence = 0;
+    bool stopping = false;
+  };
+
+  /* ahead of whole jobs, since the thread that forked holds one of them while it waits */
+  static constexpr int ForkPriority = INT_MAX;
+
+  /* the tasks of one run_all(), shared with the jobs offering them to the pool; each runs once, on whichever
+   * thread claims it first */
+  struct Fork {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<bool> claimed;
+    size_t running = 0;
+    std::exception_ptr error;
+    // only read by whoever claimed a task, which run_all() waits for
+    const std::function<void(size_t)> *task = nullptr;
+
+    void run(const size_t index) {
+      {
+        std::lock_guard lock(mutex);
+        if (claimed[index] || error) {
+          claimed[index] = true;
+          return;
+        }
+        claimed[index] = true;
+        ++running;
+      }
+      std::exception_ptr thrown;
+      try {
+        (*task)(index);
+      } catch (...) {
+        thrown = std::current_exception();
+      }
+      {
+        std::lock_guard lock(mutex);
+        --running;
+        if (thrown && !error) {
+          error = thrown;
+        }
+      }
+      condition.notify_all();
+    }
+  };
+
+  std::shared_ptr<State> state;
+  size_t threads;
+
+  static void work(State &state) {
+    std::unique_lock lock(state.mutex);
+    while (true) {
+      state.condition.wait(lock, [&] { return state.stopping || !state.queue.empty(); });
+      if (state.queue.empty()) {
+        return;
+      }
+      std::pop_heap(state.queue.begin(), state.queue.end(), Entry::later);
+      auto job = std::move(state.queue.back().job);
+      state.queue.pop_back();
+      ++state.active;
+
+      lock.unlock();
+      job();
+      job = nullptr;
+      lock.lock();
+
+      --state.active;
+    }
+  }
+
+  static auto shared_mutex() -> std::mutex & {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static auto shared_pool() -> std::shared_ptr<WorkerPool> & {
+    static std::shared_ptr<WorkerPool> pool;
+    return pool;
+  }
+};
+
+#endif  // SRC_WORKER_POOL_HPP_
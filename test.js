@@ -20,11 +20,22 @@ const subSong = vgmstream.selectSubSong(1)
 
 console.log(subSong.info)
 
+// every block starts straight away, `pending` tells when they are all done
+const pending = []
 const timing = key => cb => {
   const begin = Date.now()
-  cb(() => {
+  const done = new Promise(resolve => cb(() => {
     console.log(`[${key}] cost: ${Date.now() - begin}ms`)
-  })
+    resolve()
+  }))
+  pending.push(done)
+  return done
+}
+
+// blocks that reconfigure process-wide state run alone, one after another, once every other block is done
+const exclusive = []
+const alone = key => cb => {
+  exclusive.push([key, cb])
 }
 
 timing('sync')(finish => {
@@ -53,3 +64,255 @@ timing('async')(finish => {
     finish()
   })
 })
+
+timing('stream')(finish => {
+  const chunks = [];
+
+  vgmstream.selectSubSong(1).stream({ chunkSize: 4096 })
+    .on('data', chunk => chunks.push(chunk))
+    .on('end', () => {
+      const streamed = Buffer.concat(chunks);
+      console.log('streamed chunks: ', chunks.length, 'bytes: ', streamed.length);
+      console.log('stream matches renderSync: ', streamed.equals(vgmstream.selectSubSong(1).renderSync()));
+      finish();
+    });
+})
+
+timing('range')(finish => {
+  const { sampleRate, channels } = subSong.info;
+  const slice = subSong.renderSync({ startTime: 0.5, endTime: 1.5 });
+  console.log('1s slice bytes: ', slice.length, 'expected: ', 44 + sampleRate * channels * 2);
+  finish();
+})
+
+timing('batch')(async finish => {
+  const lengths = [];
+
+  for await (const { index, data, error } of vgmstream.renderAll()) {
+    lengths[index - 1] = error ? -1 : data.length;
+  }
+
+  console.log(lengths)
+
+  finish();
+})
+
+timing('formats')(finish => {
+  const wave = subSong.renderSync({ end: 4096 });
+  const raw = subSong.renderSync({ end: 4096, format: 's16le' });
+  const float = subSong.renderSync({ end: 4096, format: 'f32le' });
+  const planes = subSong.renderSync({ end: 4096, format: 'planar' });
+  console.log('raw matches wav data: ', raw.equals(wave.subarray(wave.length - raw.length)));
+  console.log('f32le bytes: ', float.length, 'planes: ', planes.length, planes[0].length);
+  finish();
+})
+
+timing('loop')(async finish => {
+  const once = subSong.renderSync({ format: 's16le', ignoreLoop: true });
+  const twice = subSong.renderSync({ format: 's16le', loopCount: 2, fadeTime: 1 });
+  console.log('single pass bytes: ', once.length, 'two loops + fade bytes: ', twice.length);
+
+  const reader = subSong.openReader({ playForever: true, format: 's16le' });
+  let streamed = 0;
+  for (let i = 0; i < 8; ++i) {
+    streamed += (await reader.read()).length;
+  }
+  reader.close();
+  console.log('play forever still reading after bytes: ', streamed);
+  finish();
+})
+
+timing('probe')(async finish => {
+  const summaries = await vgmstream.probe();
+  console.log('probed: ', summaries.length, 'first: ', summaries[0]);
+  finish();
+})
+
+timing('mmap')(finish => {
+  const mapped = new VGMStream(path.join(__dirname, 'test.bank'));
+  console.log('mapped sub songs: ', mapped.subSongCount);
+  console.log('mapped matches buffer: ', mapped.selectSubSong(1).renderSync().equals(subSong.renderSync()));
+  finish();
+})
+
+timing('companions')(finish => {
+  const txth = Buffer.from('codec = PCM16LE\nchannels = 1\nsample_rate = 8000\nnum_samples = data_size\n');
+  const raw = new VGMStream(Buffer.alloc(16000), 'tone.raw', { files: { '.raw.txth': txth } });
+  console.log('txth companion samples: ', raw.selectSubSong(1).info.numberOfSamples, 'expected: ', 8000);
+  finish();
+})
+
+timing('decoder pool')(async finish => {
+  const first = await subSong.render();
+  const again = await Promise.all([subSong.render(), subSong.render()]);
+  console.log('pooled renders match: ', again.every(data => data.equals(first)));
+  finish();
+})
+
+alone('cache')(async finish => {
+  VGMStream.configure({ cacheBytes: 256 * 1024 * 1024 });
+  const cold = await subSong.render();
+  const hot = await subSong.render();
+  console.log('cached render matches: ', hot.equals(cold), VGMStream.stats.cache);
+  VGMStream.configure({ cacheBytes: 0 });
+  finish();
+})
+
+timing('cancel')(async finish => {
+  const controller = new AbortController();
+  const aborted = subSong.render({ signal: controller.signal, loopCount: 100 });
+  controller.abort();
+  const timedOut = subSong.render({ timeout: 1, loopCount: 100 });
+  const outcomes = await Promise.allSettled([aborted, timedOut]);
+  console.log('cancelled renders: ', outcomes.map(outcome => outcome.reason && outcome.reason.message));
+  finish();
+})
+
+timing('stats')(async finish => {
+  const { data, stats } = await subSong.render({ stats: true });
+  console.log('render stats: ', data.length === stats.bytes, stats);
+  console.log('module stats: ', VGMStream.stats.renders);
+  finish();
+})
+
+timing('channels')(finish => {
+  const { channels, numberOfSamples } = subSong.info;
+  const first = subSong.renderSync({ format: 's16le', channels: [0] });
+  const mono = subSong.renderSync({ format: 's16le', downmix: 'mono' });
+  const expected = numberOfSamples * 2;
+  console.log('channel subset bytes: ', first.length, 'expected: ', expected, 'matches: ', first.length === expected);
+  console.log('mono bytes: ', mono.length, 'matches: ', mono.length === expected, 'source channels: ', channels);
+  finish();
+})
+
+timing('resample')(finish => {
+  const { numberOfSamples, sampleRate, channels } = subSong.info;
+  const resampled = subSong.renderSync({ format: 's16le', sampleRate: 48000 });
+  const expected = Math.ceil(numberOfSamples * 48000 / sampleRate) * channels * 2;
+  console.log('resampled bytes: ', resampled.length, 'expected: ', expected);
+  finish();
+})
+
+timing('worker threads')(async finish => {
+  const { Worker } = require('worker_threads');
+  const source = `
+    const { parentPort, workerData } = require('worker_threads');
+    const { VGMStream } = require(workerData.lib);
+    const stream = new VGMStream(require('fs').readFileSync(workerData.bank), 'test.bank');
+    stream.selectSubSong(1).render().then(data => parentPort.postMessage(data));
+  `;
+  const workerData = { lib: path.join(__dirname, 'lib'), bank: path.join(__dirname, 'test.bank') };
+  const expected = subSong.renderSync();
+  const results = await Promise.all(Array.from({ length: 4 }, () => new Promise((resolve, reject) => {
+    const worker = new Worker(source, { eval: true, workerData });
+    worker.once('message', data => resolve(Buffer.from(data)));
+    worker.once('error', reject);
+  })));
+  console.log('worker renders match: ', results.every(data => data.equals(expected)));
+  finish();
+})
+
+timing('flac')(async finish => {
+  const flac = subSong.renderSync({ format: 'flac' });
+  const chunks = [];
+  for await (const chunk of subSong.stream({ format: 'flac', chunkSize: 1000 })) {
+    chunks.push(chunk);
+  }
+  const streamed = Buffer.concat(chunks);
+  console.log('flac bytes: ', flac.length, 'magic: ', flac.subarray(0, 4).toString(), 'streamed matches: ', streamed.equals(flac));
+  finish();
+})
+
+timing('open async')(async finish => {
+  const opened = await VGMStream.open(buffer, 'test.bank');
+  const selected = await opened.selectSubSongAsync(1);
+  console.log('async open sub songs: ', opened.subSongCount, 'info matches: ', selected.info.numberOfSamples === subSong.info.numberOfSamples);
+  finish();
+})
+
+timing('parallel')(async finish => {
+  const samples = 44100 * 4;
+  const pcm = Buffer.alloc(samples * 4);
+  for (let i = 0; i < samples * 2; ++i) {
+    pcm.writeInt16LE(Math.round(8000 * Math.sin(i / 7) + 4000 * Math.sin(i / 131)), i * 2);
+  }
+  const header = Buffer.alloc(44);
+  header.write('RIFF', 0);
+  header.writeUInt32LE(36 + pcm.length, 4);
+  header.write('WAVEfmt ', 8);
+  header.writeUInt32LE(16, 16);
+  header.writeUInt16LE(1, 20);
+  header.writeUInt16LE(2, 22);
+  header.writeUInt32LE(44100, 24);
+  header.writeUInt32LE(44100 * 4, 28);
+  header.writeUInt16LE(4, 32);
+  header.writeUInt16LE(16, 34);
+  header.write('data', 36);
+  header.writeUInt32LE(pcm.length, 40);
+  const wav = new VGMStream(Buffer.concat([header, pcm]), 'tone.wav').selectSubSong(1);
+
+  const matches = [];
+  for (const format of ['wav', 'f32le', 'planar']) {
+    const serial = wav.renderSync({ format, start: 1000 });
+    const parallel = await wav.render({ format, start: 1000, parallel: 4 });
+    matches.push(format === 'planar'
+      ? serial.every((plane, channel) => Buffer.from(plane.buffer, plane.byteOffset, plane.byteLength)
+        .equals(Buffer.from(parallel[channel].buffer, parallel[channel].byteOffset, parallel[channel].byteLength)))
+      : serial.equals(parallel));
+  }
+  console.log('parallel renders match serial: ', matches);
+  const fallback = await subSong.render({ parallel: 4 });
+  console.log('parallel fallback matches serial: ', fallback.equals(subSong.renderSync()));
+  finish();
+})
+
+timing('analysis')(async finish => {
+  const { data, analysis } = await subSong.render({ format: 's16le', analyze: { peaks: 100, loudness: true } });
+  const only = subSong.renderSync({ analysisOnly: true, analyze: { peaks: 100, loudness: true } });
+  let peak = 0;
+  for (let i = 0; i < data.length; i += 2) {
+    peak = Math.max(peak, Math.abs(data.readInt16LE(i)) / 32768);
+  }
+  console.log('analysis: ', { peakDb: analysis.peakDb, rmsDb: analysis.rmsDb, loudness: analysis.loudness,
+    leadingSilence: analysis.leadingSilence, trailingSilence: analysis.trailingSilence });
+  console.log('peak matches data: ', analysis.peak === peak, 'peaks: ', analysis.peaks.length,
+    'analysis only matches: ', only.data === undefined && only.analysis.rms === analysis.rms);
+  finish();
+})
+
+alone('bank index')(async finish => {
+  const indexFile = path.join(require('os').tmpdir(), `vgmstream-index-${process.pid}`);
+  VGMStream.configure({ indexFile });
+  const listed = new VGMStream(buffer, 'test.bank').listSubSongs();
+  // a fresh load stands in for a restart
+  VGMStream.configure({ indexFile });
+  const indexed = new VGMStream(buffer, 'test.bank');
+  const matches = JSON.stringify(indexed.listSubSongs()) === JSON.stringify(listed);
+  console.log('indexed count: ', indexed.subSongCount, 'list matches: ', matches, 'index: ', VGMStream.stats.index);
+  VGMStream.configure({ indexFile: '' });
+  fs.unlinkSync(indexFile);
+  finish();
+})
+
+alone('memory budget')(async finish => {
+  // a cached render counts twice against the budget
+  VGMStream.configure({ cacheBytes: 0 });
+  const size = subSong.renderSync().length;
+  VGMStream.configure({ memoryBudget: size - 1 });
+  let rejected = null;
+  try {
+    subSong.renderSync();
+  } catch (error) {
+    rejected = error.message;
+  }
+  // room for one render at a time, the others wait their turn
+  VGMStream.configure({ memoryBudget: size * 1.5 });
+  const results = await Promise.all(Array.from({ length: 4 }, () => subSong.render()));
+  const { memory } = VGMStream.stats;
+  console.log('over budget: ', rejected, 'queued renders match: ', results.every(data => data.length === size),
+    'memory: ', memory, 'peak within budget: ', memory.peak <= memory.budget);
+  VGMStream.configure({ memoryBudget: 0 });
+  finish();
+})
+
+exclusive.reduce((previous, [key, cb]) => previous.then(() => timing(key)(cb)), Promise.all(pending))